@@ -0,0 +1,393 @@
+/* LIF image catalog
+ *
+ * Lists the directories of many LIF disk images in one merged catalog.
+ * Only the volume header and the directory sectors of each image are read.
+ * Images are shared out between worker threads but the catalog is always
+ * written in the order the images were given, so it is reproducible.
+ */
+
+#include "lifcatalog.h"
+#include "lifimage.h"
+#include "liffiletype.h"
+#include "liftime.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+/* Growable output buffer, one per image */
+typedef struct {
+	char* data;
+	size_t len;
+	size_t size;
+	int failed;
+} OUTBUF;
+
+/* Work slot for one image */
+typedef struct {
+	char* path;
+	OUTBUF out;
+	int result;
+	int done;
+} CATSLOT;
+
+/* State shared between the worker threads and the writer */
+typedef struct {
+	CATSLOT* slots;
+	int nSlots;
+	int next;
+	int format;
+	pthread_mutex_t lock;
+	pthread_cond_t finished;
+} CATALOG;
+
+static void Append(OUTBUF* out, const char* data, size_t len) {
+
+	char* newPtr;
+	size_t newSize;
+
+	if (out->failed) return;
+
+	if (out->len + len > out->size) {
+		newSize = out->size ? out->size : 4096;
+		while (out->len + len > newSize) newSize <<= 1;
+		if (!(newPtr = (char*)realloc(out->data, newSize))) {
+			out->failed = 1;
+			return;
+		}
+		out->data = newPtr;
+		out->size = newSize;
+	}
+
+	memcpy(out->data + out->len, data, len);
+	out->len += len;
+
+}
+
+static void AppendString(OUTBUF* out, const char* s) {
+	Append(out, s, strlen(s));
+}
+
+/* Append a string as a quoted JSON string */
+static void AppendJSONString(OUTBUF* out, const char* s, size_t len) {
+
+	char esc[8];
+	size_t n;
+	unsigned char c;
+
+	Append(out, "\"", 1);
+	for (n = 0; n < len; ++n) {
+		c = (unsigned char)s[n];
+		if (c == '"' || c == '\\') {
+			esc[0] = '\\';
+			esc[1] = c;
+			Append(out, esc, 2);
+		}
+		else if (c < 0x20 || c >= 0x7f) {
+			sprintf(esc, "\\u%04x", c);
+			Append(out, esc, 6);
+		}
+		else Append(out, (char*)&c, 1);
+	}
+	Append(out, "\"", 1);
+
+}
+
+/* Write a string to a stream as a quoted JSON string */
+void PrintJSONString(FILE* outStream, const char* s, size_t len) {
+
+	OUTBUF out;
+
+	memset(&out, 0, sizeof(out));
+	AppendJSONString(&out, s, len);
+	if (out.data && !out.failed) fwrite(out.data, 1, out.len, outStream);
+	free(out.data);
+
+}
+
+static void AppendUInt32(OUTBUF* out, uint32_t v) {
+
+	byte b[4];
+
+	b[0] = v >> 24;
+	b[1] = v >> 16;
+	b[2] = v >> 8;
+	b[3] = v;
+	Append(out, (char*)b, 4);
+
+}
+
+/* One JSON object per directory entry */
+static void FormatJSONL(OUTBUF* out, const char* path, PLIFHDR entries, int count) {
+
+	char field[96];
+	char stamp[TIMESTAMPTEXTLENGTH];
+	const char* desc;
+	size_t nameLen;
+	uint32_t nSectors;
+	uint16_t lifType;
+	int n, used;
+
+	for (n = 0; n < count; ++n) {
+		PLIFHDR hdr = &entries[n];
+
+		/* LIF names are padded with trailing spaces */
+		for (nameLen = FILENAMELENGTH; nameLen && hdr->fileName[nameLen-1] == ' '; --nameLen);
+
+		lifType = ntohs(hdr->fileType);
+		nSectors = ntohl(hdr->fileSize);
+		used = GetRealFileLength(hdr);
+		desc = lifDescriptionFromID(lifType);
+		FormatLIFTimestamp(hdr->timestamp, stamp);
+
+		AppendString(out, "{\"image\":");
+		AppendJSONString(out, path, strlen(path));
+		AppendString(out, ",\"name\":");
+		AppendJSONString(out, hdr->fileName, nameLen);
+		sprintf(field, ",\"type\":\"0x%04x\",\"desc\":", lifType);
+		AppendString(out, field);
+		if (desc) AppendJSONString(out, desc, strlen(desc));
+		else AppendString(out, "null");
+		sprintf(field, ",\"start\":%u,\"sectors\":%u,\"bytes\":%lu,\"used\":",
+			(unsigned)ntohl(hdr->startSector), (unsigned)nSectors, (unsigned long)nSectors * BYTESPERSECTOR);
+		AppendString(out, field);
+		if (used >= 0) sprintf(field, "%d", used);
+		else strcpy(field, "null");
+		AppendString(out, field);
+		if (ValidLIFTimestamp(hdr->timestamp)) sprintf(field, ",\"timestamp\":\"%s\"}\n", stamp);
+		else strcpy(field, ",\"timestamp\":null}\n");
+		AppendString(out, field);
+	}
+
+}
+
+/* Path length, path, entry count and then the raw 32 byte directory entries */
+static void FormatBinary(OUTBUF* out, const char* path, PLIFHDR entries, int count) {
+
+	size_t pathLen = strlen(path);
+	byte b[2];
+
+	if (pathLen > 0xffff) pathLen = 0xffff;
+	b[0] = pathLen >> 8;
+	b[1] = pathLen;
+	Append(out, (char*)b, 2);
+	Append(out, path, pathLen);
+	AppendUInt32(out, count);
+	Append(out, (char*)entries, (size_t)count * HEADERLENGTH);
+
+}
+
+static void CatalogOne(CATALOG* cat, CATSLOT* slot) {
+
+	PLIFHDR entries;
+	int fd, count;
+
+	if ((fd = open(slot->path, O_RDONLY | O_BINARY)) < 0) {
+		slot->result = LIFIMG_IOERR;
+		return;
+	}
+
+	slot->result = ReadLIFDirectory(fd, &entries, &count);
+	close(fd);
+	if (slot->result != LIFIMG_OK) return;
+
+	if (cat->format == CATALOG_BINARY)
+		FormatBinary(&slot->out, slot->path, entries, count);
+	else
+		FormatJSONL(&slot->out, slot->path, entries, count);
+
+	free(entries);
+	if (slot->out.failed) slot->result = LIFIMG_NOMEM;
+
+}
+
+static void* CatalogWorker(void* arg) {
+
+	CATALOG* cat = (CATALOG*)arg;
+	int index;
+
+	for (;;) {
+		pthread_mutex_lock(&cat->lock);
+		index = cat->next++;
+		pthread_mutex_unlock(&cat->lock);
+		if (index >= cat->nSlots) break;
+
+		CatalogOne(cat, &cat->slots[index]);
+
+		pthread_mutex_lock(&cat->lock);
+		cat->slots[index].done = 1;
+		pthread_cond_broadcast(&cat->finished);
+		pthread_mutex_unlock(&cat->lock);
+	}
+
+	return NULL;
+
+}
+
+static int ComparePaths(const void* a, const void* b) {
+	return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/* Add a copy of a path to a growing list */
+static int AddPath(char*** list, int* count, int* size, const char* path) {
+
+	char** newList;
+
+	if (*count == *size) {
+		*size = *size ? *size * 2 : 64;
+		if (!(newList = (char**)realloc(*list, *size * sizeof(char*)))) return 0;
+		*list = newList;
+	}
+
+	if (!((*list)[*count] = strdup(path))) return 0;
+	++*count;
+	return 1;
+
+}
+
+/* Expand directories into the sorted list of files they contain */
+char** ExpandImageList(char** paths, int nPaths, int* nImages) {
+
+	char** list = NULL;
+	int count = 0, size = 0, first, n;
+	struct stat statbuf;
+	struct dirent* de;
+	DIR* dir;
+	char* full;
+
+	for (n = 0; n < nPaths; ++n) {
+
+		/* Plain files, and anything we can't stat, are passed through and reported later */
+		if (stat(paths[n], &statbuf) || !S_ISDIR(statbuf.st_mode)) {
+			if (!AddPath(&list, &count, &size, paths[n])) goto nomem;
+			continue;
+		}
+
+		if (!(dir = opendir(paths[n]))) {
+			fprintf(stderr, "WARNING: Could not read directory %s\n", paths[n]);
+			continue;
+		}
+
+		first = count;
+		while ((de = readdir(dir))) {
+			if (de->d_name[0] == '.') continue;
+			if (!(full = (char*)malloc(strlen(paths[n]) + strlen(de->d_name) + 2))) {
+				closedir(dir);
+				goto nomem;
+			}
+			sprintf(full, "%s/%s", paths[n], de->d_name);
+			if (!stat(full, &statbuf) && S_ISREG(statbuf.st_mode)) {
+				if (!AddPath(&list, &count, &size, full)) {
+					free(full);
+					closedir(dir);
+					goto nomem;
+				}
+			}
+			free(full);
+		}
+		closedir(dir);
+
+		/* readdir() order depends on the file system, so sort each directory's files */
+		qsort(list + first, count - first, sizeof(char*), ComparePaths);
+	}
+
+	*nImages = count;
+	if (!list) list = (char**)malloc(sizeof(char*));
+	return list;
+
+nomem:
+	FreeImageList(list, count);
+	*nImages = 0;
+	return NULL;
+
+}
+
+void FreeImageList(char** list, int count) {
+
+	int n;
+
+	if (!list) return;
+	for (n = 0; n < count; ++n) free(list[n]);
+	free(list);
+
+}
+
+/* Catalog the given LIF images */
+int CatalogImages(char** paths, int nPaths, FILE* outStream, int format, int jobs) {
+
+	CATALOG cat;
+	pthread_t* threads;
+	int n, started, result = 0;
+
+	if (jobs <= 0) {
+#ifdef _SC_NPROCESSORS_ONLN
+		jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+		if (jobs <= 0) jobs = 4;
+	}
+	if (jobs > nPaths) jobs = nPaths;
+
+	if (format == CATALOG_BINARY) fwrite(CATALOG_MAGIC, 1, strlen(CATALOG_MAGIC), outStream);
+	if (!nPaths) return 0;
+
+	cat.slots = (CATSLOT*)calloc(nPaths, sizeof(CATSLOT));
+	threads = (pthread_t*)malloc(jobs * sizeof(pthread_t));
+	if (!cat.slots || !threads) {
+		free(cat.slots);
+		free(threads);
+		fprintf(stderr, "ERROR: Out of memory building catalog.\n");
+		return 13;
+	}
+
+	for (n = 0; n < nPaths; ++n) cat.slots[n].path = paths[n];
+	cat.nSlots = nPaths;
+	cat.next = 0;
+	cat.format = format;
+	pthread_mutex_init(&cat.lock, NULL);
+	pthread_cond_init(&cat.finished, NULL);
+
+	for (started = 0; started < jobs; ++started) {
+		if (pthread_create(&threads[started], NULL, CatalogWorker, &cat)) break;
+	}
+
+	/* Couldn't start any threads at all? Do the work here instead. */
+	if (!started) CatalogWorker(&cat);
+
+	/* Write each image's part of the catalog as soon as it and all those before it are ready */
+	for (n = 0; n < nPaths; ++n) {
+		CATSLOT* slot = &cat.slots[n];
+
+		pthread_mutex_lock(&cat.lock);
+		while (!slot->done) pthread_cond_wait(&cat.finished, &cat.lock);
+		pthread_mutex_unlock(&cat.lock);
+
+		if (slot->result != LIFIMG_OK) {
+			fprintf(stderr, "ERROR: %s: %s\n", slot->path, LIFImageError(slot->result));
+			result = 14;
+		}
+		else if (slot->out.len && fwrite(slot->out.data, 1, slot->out.len, outStream) != slot->out.len) {
+			fprintf(stderr, "ERROR: Unable to write to output.\n");
+			result = 11;
+		}
+
+		free(slot->out.data);
+		slot->out.data = NULL;
+	}
+
+	for (n = 0; n < started; ++n) pthread_join(threads[n], NULL);
+
+	pthread_cond_destroy(&cat.finished);
+	pthread_mutex_destroy(&cat.lock);
+	free(threads);
+	free(cat.slots);
+
+	return result;
+
+}
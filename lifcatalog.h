@@ -0,0 +1,30 @@
+/* LIF image catalog
+ *
+ * Lists the directories of many LIF disk images in one merged catalog.
+ */
+
+#ifndef LIFCATALOG_H
+#define LIFCATALOG_H
+
+#include <stdio.h>
+
+/* Catalog output formats */
+#define CATALOG_JSONL	0
+#define CATALOG_BINARY	1
+
+/* Magic string at the start of a binary catalog */
+#define CATALOG_MAGIC	"LIFCAT01"
+
+/* Expand directories into the sorted list of files they contain. Returns NULL when out of memory. */
+char** ExpandImageList(char**, int, int*);
+
+/* Catalog the given LIF images with the given number of worker threads. Returns an error code. */
+int CatalogImages(char**, int, FILE*, int, int);
+
+/* Write a string to a stream as a quoted JSON string */
+void PrintJSONString(FILE*, const char*, size_t);
+
+/* Free a list built by ExpandImageList() */
+void FreeImageList(char**, int);
+
+#endif
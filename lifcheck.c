@@ -0,0 +1,322 @@
+/* Differential checks for the LIF header codecs
+ *
+ * Run with "make check". Checks that:
+ *  - SetLIFSize() and GetRealFileLength() round-trip every payload size that
+ *    each type in fileTypes[] can hold;
+ *  - the table driven timestamp code in liftime.c gives the same results as
+ *    the plain BCD2int()/int2BCD() and localtime_r() code it replaced;
+ *  - ValidLIFTimestamp() agrees with the C library about which dates exist.
+ *
+ * Any faster version of these routines should be checked against the plain
+ * ones here in the same way before it replaces them.
+ */
+
+#include "lifheader.h"
+#include "liffiletype.h"
+#include "liftime.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Largest payload an HP-71B header can describe: the nybble count has 24 bits */
+#define MAXHP71BYTES	((1L << 23) - 1)
+
+/* HP-41C register counts have 16 bits */
+#define MAXREGISTERS	65536L
+
+/* No expectation for this size: it doesn't fit in the header */
+#define OUTOFRANGE		-2
+
+static long failures = 0;
+
+#define FAIL(...) do { \
+	if (failures++ < 20) fprintf(stderr, "FAIL: " __VA_ARGS__); \
+} while (0)
+
+/* Small deterministic random number generator (xorshift64) */
+static uint64_t randomState = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t Random() {
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 7;
+	randomState ^= randomState << 17;
+	return randomState;
+}
+
+/* What GetRealFileLength() should give back for a header made by -a add */
+static long ExpectedLength(uint16_t fileType, long n) {
+
+	switch (fileType) {
+
+		case 0xe204: case 0xe205: case 0xe206: case 0xe207:	/* BIN */
+		case 0xe208: case 0xe209: case 0xe20a: case 0xe20b:	/* LEX */
+		case 0xe20c: case 0xe20d:							/* KEY */
+		case 0xe214: case 0xe215: case 0xe216: case 0xe217:	/* BASIC */
+		case 0xe21c:										/* ROM */
+		case 0xe222:										/* graphics */
+			return n <= MAXHP71BYTES ? n : OUTOFRANGE;
+
+		/* Text and FRAM files are measured in whole sectors */
+		case 0x0001: case 0xe0d1:
+		case 0xe218: case 0xe219: case 0xe21a: case 0xe21b:
+			return ((n + BYTESPERSECTOR - 1) / BYTESPERSECTOR) * BYTESPERSECTOR;
+
+		/* SDATA counts whole 8 byte registers */
+		case 0xe0d0:
+			return n < MAXREGISTERS * 8 ? n & ~7L : OUTOFRANGE;
+
+		/* These count registers plus one byte */
+		case 0xe040: case 0xe050: case 0xe060: case 0xe070:
+			return (n >= 1 && n <= MAXREGISTERS * 8) ? ((n - 1) & ~7L) + 1 : OUTOFRANGE;
+
+		case 0xe080:
+			return (n >= 1 && n <= MAXREGISTERS) ? n : OUTOFRANGE;
+
+		/* DATA files need the record length, which a plain byte count doesn't give */
+		case 0xe0f0: case 0xe0f1:
+			return 0;
+
+	}
+
+	return OUTOFRANGE - 1;
+
+}
+
+/* SetLIFSize() then GetRealFileLength() for every size of every known type */
+static void CheckLengths() {
+
+	LIFHDR hdr;
+	long n, expected, got;
+	int index;
+
+	for (index = 0; fileTypes[index] != LIF_UNKNOWN; ++index) {
+		uint16_t fileType = fileTypes[index];
+
+		if (!lifDescriptionFromID(fileType)) FAIL("type 0x%04x has no description\n", fileType);
+		if (ExpectedLength(fileType, 1) == OUTOFRANGE - 1) {
+			FAIL("type 0x%04x has no expected length, add it to ExpectedLength()\n", fileType);
+			continue;
+		}
+
+		for (n = 0; n <= MAXHP71BYTES + 1; ++n) {
+			if ((expected = ExpectedLength(fileType, n)) == OUTOFRANGE) continue;
+
+			/* The same steps as -a add */
+			memset(&hdr, 0, sizeof(hdr));
+			hdr.fileType = htons(fileType);
+			hdr.fileSize = htonl(n ? ((n - 1) >> 8) + 1 : 0);
+			SetLIFSize(&hdr, n);
+
+			if ((got = GetRealFileLength(&hdr)) != expected) {
+				FAIL("type 0x%04x, %ld bytes: got back %ld, expected %ld\n", fileType, n, got, expected);
+				break;
+			}
+		}
+	}
+
+}
+
+/* The lookup tables against BCD2int() and int2BCD() */
+static void CheckBCD() {
+
+	byte stamp[TIMESTAMPLENGTH], expected[TIMESTAMPLENGTH];
+	LIFTIME t;
+	int n, field, year;
+
+	/* Unpacking: every byte value in every position */
+	for (n = 0; n < 256; ++n) {
+		memset(stamp, n, TIMESTAMPLENGTH);
+		UnpackLIFTime(stamp, &t);
+		year = 1900 + BCD2int(n);
+		if (year < FIRSTYEAR) year += 100;
+		if (t.year != year || t.month != BCD2int(n) || t.day != BCD2int(n)
+			|| t.hour != BCD2int(n) || t.minute != BCD2int(n) || t.second != BCD2int(n)) {
+			FAIL("unpacking 0x%02x differs from BCD2int()\n", n);
+		}
+	}
+
+	/* Packing: every two digit value in every position */
+	for (n = 0; n < 100; ++n) {
+		t.year = FIRSTYEAR + ((n - FIRSTYEAR % 100 + 100) % 100);
+		t.month = t.day = t.hour = t.minute = t.second = n;
+		PackLIFTime(&t, stamp);
+		for (field = 0; field < TIMESTAMPLENGTH; ++field) expected[field] = int2BCD(n);
+		if (memcmp(stamp, expected, TIMESTAMPLENGTH)) FAIL("packing %d differs from int2BCD()\n", n);
+	}
+
+}
+
+/* FormatLIFTimestamp() against the sprintf() that ShowLIFHeader() used to do */
+static void CheckFormat(const byte* stamp) {
+
+	char got[64], expected[64];
+	int yr = 1900 + BCD2int((int)stamp[0]);
+	if (yr < 1970) yr += 100;
+
+	sprintf(expected, "%d-%02d-%02d %02d:%02d:%02d", yr, BCD2int((int)stamp[1]), BCD2int((int)stamp[2]),
+		BCD2int((int)stamp[3]), BCD2int((int)stamp[4]), BCD2int((int)stamp[5]));
+	FormatLIFTimestamp(stamp, got);
+	if (strcmp(got, expected)) FAIL("formatted \"%s\", expected \"%s\"\n", got, expected);
+
+}
+
+/* Does the C library think this timestamp is a real date and time? Needs TZ=UTC0. */
+static int ReferenceValid(const byte* stamp) {
+
+	struct tm tm, back;
+	time_t when;
+	int n, year;
+
+	for (n = 0; n < TIMESTAMPLENGTH; ++n) {
+		if ((stamp[n] & 0x0f) > 9 || stamp[n] > 0x99) return 0;
+	}
+
+	year = 1900 + BCD2int(stamp[0]);
+	if (year < FIRSTYEAR) year += 100;
+
+	memset(&tm, 0, sizeof(tm));
+	tm.tm_year = year - 1900;
+	tm.tm_mon = BCD2int(stamp[1]) - 1;
+	tm.tm_mday = BCD2int(stamp[2]);
+	tm.tm_hour = BCD2int(stamp[3]);
+	tm.tm_min = BCD2int(stamp[4]);
+	tm.tm_sec = BCD2int(stamp[5]);
+	tm.tm_isdst = 0;
+	back = tm;
+
+	/* mktime() normalises anything out of range, so a real date comes back unchanged */
+	when = mktime(&tm);
+	localtime_r(&when, &tm);
+	return tm.tm_year == back.tm_year && tm.tm_mon == back.tm_mon && tm.tm_mday == back.tm_mday
+		&& tm.tm_hour == back.tm_hour && tm.tm_min == back.tm_min && tm.tm_sec == back.tm_sec;
+
+}
+
+static void CheckValid(const byte* stamp) {
+
+	byte parsed[TIMESTAMPLENGTH];
+	char text[64];
+	int valid = ValidLIFTimestamp(stamp);
+
+	if (valid != ReferenceValid(stamp)) {
+		FAIL("%02x%02x%02x%02x%02x%02x: ValidLIFTimestamp() says %d\n",
+			stamp[0], stamp[1], stamp[2], stamp[3], stamp[4], stamp[5], valid);
+	}
+
+	/* A valid timestamp must survive being printed and read back */
+	if (valid) {
+		FormatLIFTimestamp(stamp, text);
+		if (!ParseLIFTimestamp(text, parsed) || memcmp(parsed, stamp, TIMESTAMPLENGTH)) {
+			FAIL("\"%s\" doesn't parse back to the same timestamp\n", text);
+		}
+	}
+
+}
+
+static void CheckTimestamps() {
+
+	static const char* const badText[] = {
+		"", "2001", "2001-02", "2001-02-03 ", "2001-02-03xyz", "2001-02-03 12", "2001-02-03 12:",
+		"2001-02-03 12:30 junk", "2001-02-03 12:30:", "2001-02-03 12:30:45x", "2001-02-03 12:30:45 ",
+		" 2001-02-03", "2001-+2-3", "2001-002-0003", "+2001-02-03 1:2:3", "2001-02-03\t12:30",
+		"2001-2-3", "2001-02-03 1:02:03", "2001-02-03  12:30", "01-02-03", NULL
+	};
+	byte stamp[TIMESTAMPLENGTH];
+	int year, month, day, field, value;
+	long n;
+
+	setenv("TZ", "UTC0", 1);
+	tzset();
+
+	/* Every year against the first 32 months and 64 days, valid BCD or not */
+	for (year = 0; year < 256; ++year) {
+		for (month = 0; month < 0x20; ++month) {
+			for (day = 0; day < 0x40; ++day) {
+				stamp[0] = year;
+				stamp[1] = month;
+				stamp[2] = day;
+				stamp[3] = 0x12;
+				stamp[4] = 0x34;
+				stamp[5] = 0x56;
+				CheckValid(stamp);
+				CheckFormat(stamp);
+			}
+		}
+	}
+
+	/* Every value of each time field */
+	for (field = 3; field < TIMESTAMPLENGTH; ++field) {
+		for (value = 0; value < 256; ++value) {
+			memcpy(stamp, "\x21\x06\x15\x00\x00\x00", TIMESTAMPLENGTH);
+			stamp[field] = value;
+			CheckValid(stamp);
+		}
+	}
+
+	/* And a good helping of random ones */
+	for (n = 0; n < 1000000; ++n) {
+		uint64_t r = Random();
+		memcpy(stamp, &r, TIMESTAMPLENGTH);
+		CheckValid(stamp);
+		CheckFormat(stamp);
+	}
+
+	/* The last second a LIF timestamp can hold */
+	UTCLIFTimestamp((time_t)(LASTEPOCH - 1), stamp);
+	if (memcmp(stamp, "\x69\x12\x31\x23\x59\x59", TIMESTAMPLENGTH)) FAIL("LASTEPOCH isn't the end of 2069\n");
+
+	/* Text that is a timestamp with something missing or left over */
+	for (n = 0; badText[n]; ++n) {
+		if (ParseLIFTimestamp(badText[n], stamp)) FAIL("\"%s\" parses as a timestamp\n", badText[n]);
+	}
+
+}
+
+/* LocalLIFTimestamp() against localtime_r() and int2BCD(), across clock changes */
+static void CheckLocalTime() {
+
+	byte got[TIMESTAMPLENGTH], expected[TIMESTAMPLENGTH];
+	struct tm tm;
+	time_t when = 0;
+	long n;
+
+	/* A POSIX rule, so it works without a time zone database */
+	setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);
+	tzset();
+
+	for (n = 0; n < 2000000; ++n) {
+		/* Mostly small steps so that every clock change gets crossed, with the odd big jump */
+		when += (n % 1000) ? (time_t)(Random() % 7200) : (time_t)(Random() % (3 * 365 * 86400L));
+
+		localtime_r(&when, &tm);
+		expected[0] = int2BCD(tm.tm_year % 100);
+		expected[1] = int2BCD(tm.tm_mon + 1);
+		expected[2] = int2BCD(tm.tm_mday);
+		expected[3] = int2BCD(tm.tm_hour);
+		expected[4] = int2BCD(tm.tm_min);
+		expected[5] = int2BCD(tm.tm_sec);
+
+		LocalLIFTimestamp(when, got);
+		if (memcmp(got, expected, TIMESTAMPLENGTH)) {
+			FAIL("local time for %lld differs from localtime_r()\n", (long long)when);
+		}
+	}
+
+}
+
+int main() {
+
+	CheckLengths();
+	CheckBCD();
+	CheckTimestamps();
+	CheckLocalTime();
+
+	if (failures) {
+		fprintf(stderr, "%ld check(s) failed\n", failures);
+		return 1;
+	}
+
+	printf("All checks passed\n");
+	return 0;
+
+}
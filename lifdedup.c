@@ -0,0 +1,463 @@
+/* Duplicate detection
+ *
+ * Finds files with identical contents among extracted LIF files and the
+ * files held in LIF images. Only the useful part of each file, as given by
+ * the length recorded in its LIF header, is compared, so neither the header
+ * itself nor the slack at the end of the last sector gets in the way.
+ *
+ * Files are only hashed if some other file has the same length, and the
+ * hashing is shared out between worker threads.
+ */
+
+#include "lifdedup.h"
+#include "lifcatalog.h"
+#include "lifimage.h"
+#include "lifhash.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+/* One file's contents, either an extracted file or an entry in a LIF image */
+typedef struct {
+	char* path;
+	char name[FILENAMELENGTH+1];	/* LIF name inside an image, empty for an extracted file */
+	long long offset;
+	long long length;
+	int index;						/* position in the input, for a stable output order */
+	int result;
+	int linked;
+	uint64_t hash;
+	unsigned char sha[SHA256LENGTH];
+} DUPITEM;
+
+/* Everything found in one input file */
+typedef struct {
+	char* path;
+	DUPITEM* items;
+	int count;
+	int result;
+	int skipped;	/* neither a LIF image nor a file with a LIF header */
+} DUPINPUT;
+
+typedef struct {
+	DUPINPUT* inputs;
+	DUPITEM** candidates;
+	int useSHA256;
+} DEDUP;
+
+/* Simple work queue: calls fn(arg, i) for every i in [0, count) */
+typedef struct {
+	void (*fn)(void*, int);
+	void* arg;
+	int count;
+	int next;
+	pthread_mutex_t lock;
+} WORKQUEUE;
+
+static void* QueueWorker(void* arg) {
+
+	WORKQUEUE* queue = (WORKQUEUE*)arg;
+	int index;
+
+	for (;;) {
+		pthread_mutex_lock(&queue->lock);
+		index = queue->next++;
+		pthread_mutex_unlock(&queue->lock);
+		if (index >= queue->count) break;
+		queue->fn(queue->arg, index);
+	}
+
+	return NULL;
+
+}
+
+static void RunParallel(void (*fn)(void*, int), void* arg, int count, int jobs) {
+
+	WORKQUEUE queue;
+	pthread_t* threads;
+	int n, started = 0;
+
+	if (jobs > count) jobs = count;
+	if (jobs < 1) jobs = 1;
+
+	queue.fn = fn;
+	queue.arg = arg;
+	queue.count = count;
+	queue.next = 0;
+	pthread_mutex_init(&queue.lock, NULL);
+
+	if ((threads = (pthread_t*)malloc(jobs * sizeof(pthread_t)))) {
+		for (started = 0; started < jobs; ++started) {
+			if (pthread_create(&threads[started], NULL, QueueWorker, &queue)) break;
+		}
+	}
+
+	/* Whatever the threads didn't pick up gets done here */
+	QueueWorker(&queue);
+
+	for (n = 0; n < started; ++n) pthread_join(threads[n], NULL);
+	free(threads);
+	pthread_mutex_destroy(&queue.lock);
+
+}
+
+/* Find the file, or the files in the LIF image, behind one input */
+static void ScanInput(void* arg, int index) {
+
+	DUPINPUT* input = &((DEDUP*)arg)->inputs[index];
+	LIFHDR hdr;
+	PLIFHDR entries;
+	struct stat statbuf;
+	long r;
+	int fd, n, count;
+
+	if ((fd = open(input->path, O_RDONLY | O_BINARY)) < 0 || fstat(fd, &statbuf)) {
+		if (fd >= 0) close(fd);
+		input->result = LIFIMG_IOERR;
+		return;
+	}
+
+	if ((r = ReadAt(fd, &hdr, HEADERLENGTH, 0)) != HEADERLENGTH) {
+		close(fd);
+		if (r < 0) input->result = LIFIMG_IOERR;
+		else input->skipped = 1;
+		return;
+	}
+
+	/* A LIF file name starts with a letter, so 0x80 at the start can only be a volume header */
+	if ((byte)hdr.fileName[0] == (LIFVOLUMEID >> 8) && !hdr.fileName[1]) {
+		input->result = ReadLIFDirectory(fd, &entries, &count);
+		close(fd);
+		if (input->result != LIFIMG_OK || !count) return;
+
+		if (!(input->items = (DUPITEM*)calloc(count, sizeof(DUPITEM)))) {
+			free(entries);
+			input->result = LIFIMG_NOMEM;
+			return;
+		}
+
+		for (n = 0; n < count; ++n) {
+			DUPITEM* item = &input->items[n];
+			item->path = input->path;
+			memcpy(item->name, entries[n].fileName, FILENAMELENGTH);
+			item->offset = (long long)ntohl(entries[n].startSector) * BYTESPERSECTOR;
+			item->length = LIFPayloadLength(&entries[n], (long long)statbuf.st_size - item->offset);
+		}
+		input->count = count;
+		free(entries);
+		return;
+	}
+
+	close(fd);
+
+	/* Otherwise it should be a file with its LIF header still attached */
+	if (!PlausibleLIFHeader(&hdr, (long long)statbuf.st_size - HEADERLENGTH)) {
+		input->skipped = 1;
+		return;
+	}
+
+	if (!(input->items = (DUPITEM*)calloc(1, sizeof(DUPITEM)))) {
+		input->result = LIFIMG_NOMEM;
+		return;
+	}
+	input->items->path = input->path;
+	input->items->offset = HEADERLENGTH;
+	input->items->length = LIFPayloadLength(&hdr, (long long)statbuf.st_size - HEADERLENGTH);
+	input->count = 1;
+
+}
+
+/* Hash one candidate's contents using large reads */
+static void HashItem(void* arg, int index) {
+
+	DEDUP* dedup = (DEDUP*)arg;
+	DUPITEM* item = dedup->candidates[index];
+	HASH64CTX hash;
+	SHA256CTX sha;
+	byte* buffer;
+	long long done = 0;
+	long want, r;
+	int fd;
+
+	if ((fd = open(item->path, O_RDONLY | O_BINARY)) < 0) {
+		item->result = LIFIMG_IOERR;
+		return;
+	}
+
+	want = item->length < DEDUPREADSIZE ? (long)item->length : DEDUPREADSIZE;
+	if (!(buffer = (byte*)malloc(want))) {
+		close(fd);
+		item->result = LIFIMG_NOMEM;
+		return;
+	}
+
+	Hash64Init(&hash, 0);
+	if (dedup->useSHA256) SHA256Init(&sha);
+
+	while (done < item->length) {
+		if (item->length - done < want) want = (long)(item->length - done);
+		r = ReadAt(fd, buffer, want, item->offset + done);
+		if (r != want) {
+			item->result = LIFIMG_IOERR;
+			break;
+		}
+		Hash64Update(&hash, buffer, r);
+		if (dedup->useSHA256) SHA256Update(&sha, buffer, r);
+		done += r;
+	}
+
+	item->hash = Hash64Final(&hash);
+	if (dedup->useSHA256) SHA256Final(&sha, item->sha);
+
+	free(buffer);
+	close(fd);
+
+}
+
+static int CompareLength(const void* a, const void* b) {
+
+	const DUPITEM* x = *(DUPITEM* const*)a;
+	const DUPITEM* y = *(DUPITEM* const*)b;
+
+	if (x->length != y->length) return x->length < y->length ? -1 : 1;
+	return x->index - y->index;
+
+}
+
+static int CompareContents(const void* a, const void* b) {
+
+	const DUPITEM* x = *(DUPITEM* const*)a;
+	const DUPITEM* y = *(DUPITEM* const*)b;
+	int c;
+
+	if (x->length != y->length) return x->length < y->length ? -1 : 1;
+	if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+	if ((c = memcmp(x->sha, y->sha, SHA256LENGTH))) return c;
+	return x->index - y->index;
+
+}
+
+/* Groups are listed in the order their first members were given */
+static int CompareGroups(const void* a, const void* b) {
+	return (*(DUPITEM** const*)a)[0]->index - (*(DUPITEM** const*)b)[0]->index;
+}
+
+static int SameContents(DUPITEM* x, DUPITEM* y) {
+	if (x->length != y->length || x->hash != y->hash) return 0;
+	return !memcmp(x->sha, y->sha, SHA256LENGTH);
+}
+
+/* Are two whole files byte for byte the same? */
+static int SameFiles(const char* first, const char* second) {
+
+	struct stat s1, s2;
+	byte b1[BYTESPERSECTOR * 16], b2[BYTESPERSECTOR * 16];
+	FILE *f1, *f2;
+	size_t r1, r2;
+	int same = 0;
+
+	if (stat(first, &s1) || stat(second, &s2) || s1.st_size != s2.st_size) return 0;
+	if (!(f1 = fopen(first, "rb"))) return 0;
+	if ((f2 = fopen(second, "rb"))) {
+		do {
+			r1 = fread(b1, 1, sizeof(b1), f1);
+			r2 = fread(b2, 1, sizeof(b2), f2);
+			same = (r1 == r2) && !memcmp(b1, b2, r1);
+		} while (same && r1);
+		fclose(f2);
+	}
+	fclose(f1);
+	return same;
+
+}
+
+/* Replace duplicate extracted files by hard links to the first copy. The
+ * headers are part of the files, so only files whose headers match too can
+ * be linked; the others are just reported. */
+static void LinkGroup(DUPITEM** group, int count) {
+
+	int n, m;
+
+	for (n = 1; n < count; ++n) {
+		DUPITEM* item = group[n];
+		if (item->name[0]) continue;
+
+		for (m = 0; m < n; ++m) {
+			DUPITEM* first = group[m];
+			if (first->name[0] || !SameFiles(first->path, item->path)) continue;
+#ifdef __WIN32
+			fprintf(stderr, "WARNING: Hard links are not supported on this system\n");
+			return;
+#else
+			struct stat s1, s2;
+			char* temp;
+			int tries, linked;
+
+			/* Already the same file? */
+			if (!stat(first->path, &s1) && !stat(item->path, &s2) && s1.st_dev == s2.st_dev && s1.st_ino == s2.st_ino) {
+				item->linked = 1;
+				break;
+			}
+
+			/* Link beside the duplicate under a name nobody else has, then move it over, so it's never missing */
+			if (!(temp = (char*)malloc(strlen(item->path) + 32))) return;
+			for (tries = 0, linked = 0; tries < 100; ++tries) {
+				sprintf(temp, "%s.lifdup%d.%d", item->path, (int)getpid(), tries);
+				if (!link(first->path, temp)) linked = 1;
+				if (linked || errno != EEXIST) break;
+			}
+			if (linked && !rename(temp, item->path)) item->linked = 1;
+			else {
+				if (linked) unlink(temp);	/* only ever remove the link made here */
+				fprintf(stderr, "WARNING: Could not link %s to %s\n", item->path, first->path);
+			}
+			free(temp);
+			break;
+#endif
+		}
+	}
+
+}
+
+static void PrintGroup(FILE* outStream, DUPITEM** group, int count, int useSHA256) {
+
+	size_t nameLen;
+	int n;
+
+	fprintf(outStream, "{\"hash\":\"%016llx\"", (unsigned long long)group[0]->hash);
+	if (useSHA256) {
+		fprintf(outStream, ",\"sha256\":\"");
+		for (n = 0; n < SHA256LENGTH; ++n) fprintf(outStream, "%02x", group[0]->sha[n]);
+		fprintf(outStream, "\"");
+	}
+	fprintf(outStream, ",\"bytes\":%lld,\"count\":%d,\"members\":[", group[0]->length, count);
+
+	for (n = 0; n < count; ++n) {
+		DUPITEM* item = group[n];
+		fprintf(outStream, "%s{\"path\":", n ? "," : "");
+		PrintJSONString(outStream, item->path, strlen(item->path));
+		if (item->name[0]) {
+			for (nameLen = FILENAMELENGTH; nameLen && item->name[nameLen-1] == ' '; --nameLen);
+			fprintf(outStream, ",\"name\":");
+			PrintJSONString(outStream, item->name, nameLen);
+		}
+		if (item->linked) fprintf(outStream, ",\"linked\":true");
+		fprintf(outStream, "}");
+	}
+
+	fprintf(outStream, "]}\n");
+
+}
+
+/* Find the duplicates among the given files and images */
+int DedupFiles(char** paths, int nPaths, FILE* outStream, int useSHA256, int link, int jobs) {
+
+	DEDUP dedup;
+	DUPITEM** all = NULL;
+	DUPITEM*** groups = NULL;
+	int* groupSizes = NULL;
+	int n, m, first, nItems = 0, nCandidates = 0, nGroups = 0, result = 0;
+
+	if (jobs <= 0) {
+#ifdef _SC_NPROCESSORS_ONLN
+		jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+		if (jobs <= 0) jobs = 4;
+	}
+
+	dedup.useSHA256 = useSHA256;
+	if (!(dedup.inputs = (DUPINPUT*)calloc(nPaths ? nPaths : 1, sizeof(DUPINPUT)))) goto nomem;
+	for (n = 0; n < nPaths; ++n) dedup.inputs[n].path = paths[n];
+
+	/* Read the headers and directories */
+	RunParallel(ScanInput, &dedup, nPaths, jobs);
+
+	for (n = 0; n < nPaths; ++n) {
+		if (dedup.inputs[n].result != LIFIMG_OK) {
+			fprintf(stderr, "ERROR: %s: %s\n", paths[n], LIFImageError(dedup.inputs[n].result));
+			result = 14;
+		}
+		else if (dedup.inputs[n].skipped) {
+			fprintf(stderr, "WARNING: %s: not a LIF image or LIF file, skipped\n", paths[n]);
+		}
+		nItems += dedup.inputs[n].count;
+	}
+
+	if (!(all = (DUPITEM**)malloc((nItems ? nItems : 1) * sizeof(DUPITEM*)))) goto nomem;
+	for (n = 0, nItems = 0; n < nPaths; ++n) {
+		for (m = 0; m < dedup.inputs[n].count; ++m) {
+			all[nItems] = &dedup.inputs[n].items[m];
+			all[nItems]->index = nItems;
+			++nItems;
+		}
+	}
+
+	/* A file whose length nobody else shares can't have a duplicate, so don't read it */
+	qsort(all, nItems, sizeof(DUPITEM*), CompareLength);
+	for (n = 0; n < nItems; n = m) {
+		for (m = n + 1; m < nItems && all[m]->length == all[n]->length; ++m);
+		if (m - n > 1 && all[n]->length) {
+			while (n < m) all[nCandidates++] = all[n++];
+		}
+	}
+
+	dedup.candidates = all;
+	RunParallel(HashItem, &dedup, nCandidates, jobs);
+
+	/* Anything that couldn't be read all the way through drops out */
+	for (n = 0, m = 0; n < nCandidates; ++n) {
+		if (all[n]->result != LIFIMG_OK) {
+			fprintf(stderr, "ERROR: %s: %s\n", all[n]->path, LIFImageError(all[n]->result));
+			result = 14;
+		}
+		else all[m++] = all[n];
+	}
+	nCandidates = m;
+
+	/* Bring identical contents together and pick out the groups */
+	qsort(all, nCandidates, sizeof(DUPITEM*), CompareContents);
+	if (!(groups = (DUPITEM***)malloc((nCandidates / 2 + 1) * sizeof(DUPITEM**)))) goto nomem;
+	if (!(groupSizes = (int*)malloc((nCandidates + 1) * sizeof(int)))) goto nomem;
+
+	for (n = 0; n < nCandidates; n = m) {
+		for (m = n + 1; m < nCandidates && SameContents(all[m], all[n]); ++m);
+		if (m - n > 1) {
+			/* Group sizes are kept by the position of their first member */
+			groupSizes[n] = m - n;
+			groups[nGroups++] = &all[n];
+		}
+	}
+
+	qsort(groups, nGroups, sizeof(DUPITEM**), CompareGroups);
+
+	for (n = 0; n < nGroups; ++n) {
+		first = groups[n] - all;
+		if (link) LinkGroup(groups[n], groupSizes[first]);
+		PrintGroup(outStream, groups[n], groupSizes[first], useSHA256);
+	}
+
+	goto alldone;
+
+nomem:
+	fprintf(stderr, "ERROR: Out of memory looking for duplicates.\n");
+	result = 13;
+
+alldone:
+	if (dedup.inputs) {
+		for (n = 0; n < nPaths; ++n) free(dedup.inputs[n].items);
+		free(dedup.inputs);
+	}
+	free(all);
+	free(groups);
+	free(groupSizes);
+	return result;
+
+}
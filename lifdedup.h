@@ -0,0 +1,18 @@
+/* Duplicate detection
+ *
+ * Finds files with identical contents among extracted LIF files and the
+ * files held in LIF images, ignoring their LIF headers.
+ */
+
+#ifndef LIFDEDUP_H
+#define LIFDEDUP_H
+
+#include <stdio.h>
+
+/* Size of each read when hashing file contents */
+#define DEDUPREADSIZE	(1024 * 1024)
+
+/* Find the duplicates among the given files and images. Returns an error code. */
+int DedupFiles(char**, int, FILE*, int, int, int);
+
+#endif
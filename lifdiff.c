@@ -0,0 +1,141 @@
+/* LIF image comparison
+ *
+ * Lists the files added to, removed from or modified in a LIF image relative
+ * to an earlier version of it. Files are matched by name and type. Both
+ * images are mapped into memory, so only the directories and the contents of
+ * the matched files are ever read. The contents of matched files are
+ * compared with memcmp(), which the C library vectorises; the comparison is
+ * only skipped when their used lengths differ, since they have changed anyway.
+ */
+
+#include "lifdiff.h"
+#include "lifcatalog.h"
+#include "lifimage.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* What changed between two files with the same name and type */
+#define DIFF_SIZE		0x01	/* number of sectors */
+#define DIFF_LENGTH		0x02	/* the general purpose field, usually the length */
+#define DIFF_TIMESTAMP	0x04
+#define DIFF_CONTENTS	0x08
+
+static int CompareEntries(const void* a, const void* b) {
+
+	PLIFHDR x = (PLIFHDR)a;
+	PLIFHDR y = (PLIFHDR)b;
+	int c;
+
+	if ((c = memcmp(x->fileName, y->fileName, FILENAMELENGTH))) return c;
+	return (int)ntohs(x->fileType) - (int)ntohs(y->fileType);
+
+}
+
+static void PrintEntry(FILE* outStream, const char* change, PLIFHDR hdr) {
+
+	size_t nameLen;
+
+	for (nameLen = FILENAMELENGTH; nameLen && hdr->fileName[nameLen-1] == ' '; --nameLen);
+
+	fprintf(outStream, "{\"change\":\"%s\",\"name\":", change);
+	PrintJSONString(outStream, hdr->fileName, nameLen);
+	fprintf(outStream, ",\"type\":\"0x%04x\"", (unsigned)ntohs(hdr->fileType));
+
+}
+
+/* Work out what, if anything, changed between two versions of a file */
+static int CompareFiles(const byte* oldImage, size_t oldSize, PLIFHDR oldHdr,
+	const byte* newImage, size_t newSize, PLIFHDR newHdr) {
+
+	long long oldOffset = (long long)ntohl(oldHdr->startSector) * BYTESPERSECTOR;
+	long long newOffset = (long long)ntohl(newHdr->startSector) * BYTESPERSECTOR;
+	long long oldLength = LIFPayloadLength(oldHdr, (long long)oldSize - oldOffset);
+	long long newLength = LIFPayloadLength(newHdr, (long long)newSize - newOffset);
+	int changes = 0;
+
+	if (oldHdr->fileSize != newHdr->fileSize) changes |= DIFF_SIZE;
+	if (oldHdr->generalPurpose != newHdr->generalPurpose) changes |= DIFF_LENGTH;
+	if (memcmp(oldHdr->timestamp, newHdr->timestamp, sizeof(oldHdr->timestamp))) changes |= DIFF_TIMESTAMP;
+
+	/* Different lengths mean different contents without reading anything */
+	if (oldLength != newLength) changes |= DIFF_CONTENTS;
+	else if (oldLength && memcmp(oldImage + oldOffset, newImage + newOffset, oldLength)) changes |= DIFF_CONTENTS;
+
+	return changes;
+
+}
+
+static void PrintChanges(FILE* outStream, PLIFHDR hdr, int changes) {
+
+	const char* sep = "";
+
+	PrintEntry(outStream, "modified", hdr);
+	fprintf(outStream, ",\"fields\":[");
+	if (changes & DIFF_SIZE) {
+		fprintf(outStream, "%s\"fileSize\"", sep);
+		sep = ",";
+	}
+	if (changes & DIFF_LENGTH) {
+		fprintf(outStream, "%s\"generalPurpose\"", sep);
+		sep = ",";
+	}
+	if (changes & DIFF_TIMESTAMP) fprintf(outStream, "%s\"timestamp\"", sep);
+	fprintf(outStream, "],\"contents\":%s}\n", (changes & DIFF_CONTENTS) ? "true" : "false");
+
+}
+
+/* Compare an old and a new LIF image */
+int DiffImages(const char* oldPath, const char* newPath, FILE* outStream) {
+
+	byte *oldImage = NULL, *newImage = NULL;
+	size_t oldSize = 0, newSize = 0;
+	PLIFHDR oldDir = NULL, newDir = NULL;
+	int nOld = 0, nNew = 0, o = 0, n = 0, c, changes, result;
+	const char* failed = oldPath;
+
+	if ((result = MapFile(oldPath, &oldImage, &oldSize)) != LIFIMG_OK) goto error;
+	if ((result = ParseLIFDirectory(oldImage, oldSize, &oldDir, &nOld)) != LIFIMG_OK) goto error;
+	failed = newPath;
+	if ((result = MapFile(newPath, &newImage, &newSize)) != LIFIMG_OK) goto error;
+	if ((result = ParseLIFDirectory(newImage, newSize, &newDir, &nNew)) != LIFIMG_OK) goto error;
+
+	/* Sort both directories by name and type and walk through them side by side */
+	qsort(oldDir, nOld, HEADERLENGTH, CompareEntries);
+	qsort(newDir, nNew, HEADERLENGTH, CompareEntries);
+
+	while (o < nOld || n < nNew) {
+		if (o == nOld) c = 1;
+		else if (n == nNew) c = -1;
+		else c = CompareEntries(&oldDir[o], &newDir[n]);
+
+		if (c < 0) {
+			PrintEntry(outStream, "removed", &oldDir[o++]);
+			fprintf(outStream, "}\n");
+		}
+		else if (c > 0) {
+			PrintEntry(outStream, "added", &newDir[n++]);
+			fprintf(outStream, "}\n");
+		}
+		else {
+			changes = CompareFiles(oldImage, oldSize, &oldDir[o], newImage, newSize, &newDir[n]);
+			if (changes) PrintChanges(outStream, &newDir[n], changes);
+			++o;
+			++n;
+		}
+	}
+
+	result = 0;
+	goto alldone;
+
+error:
+	fprintf(stderr, "ERROR: %s: %s\n", failed, LIFImageError(result));
+	result = (result == LIFIMG_NOMEM) ? 13 : 14;
+
+alldone:
+	free(oldDir);
+	free(newDir);
+	UnmapFile(oldImage, oldSize);
+	UnmapFile(newImage, newSize);
+	return result;
+
+}
@@ -0,0 +1,15 @@
+/* LIF image comparison
+ *
+ * Lists the files added to, removed from or modified in a LIF image relative
+ * to an earlier version of it.
+ */
+
+#ifndef LIFDIFF_H
+#define LIFDIFF_H
+
+#include <stdio.h>
+
+/* Compare an old and a new LIF image. Returns an error code. */
+int DiffImages(const char*, const char*, FILE*);
+
+#endif
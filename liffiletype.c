@@ -93,7 +93,7 @@ const char* lifDescriptions[] = {
 	"HP-41C status file",
 	"HP-41C \"WALL\" file",
 	"HP-71B DATA file",
-	"HP-71B DATA file, secure"
+	"HP-71B DATA file, secure",
 	"HP-71B FRAM file",
 	"HP-71B FRAM file, secure",
 	"HP-71B FRAM file, private",
@@ -6,6 +6,9 @@
 #include <inttypes.h>
 #include <stddef.h>
 
+/* Known file types, ending with LIF_UNKNOWN */
+extern uint16_t fileTypes[];
+
 const char* lifDescriptionFromID(uint16_t);
 uint16_t lifIDFromType(char*);
 
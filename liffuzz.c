@@ -0,0 +1,146 @@
+/* Fuzz target for the LIF header and image decoders
+ *
+ * "make fuzz" builds it for libFuzzer, "make fuzz-afl" for AFL++. Built with
+ * -DLIFFUZZ_STANDALONE it reads each file named on the command line, or
+ * STDIN, which is handy for replaying a crash.
+ *
+ * The input is used as a LIF header (its first 32 bytes), as a whole LIF
+ * image, as a LIF file name and as a timestamp string.
+ */
+
+#include "lifheader.h"
+#include "lifimage.h"
+#include "liftime.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* From lifheader.c */
+extern char* lifFileSpec;
+extern char lifName[FILENAMELENGTH];
+extern int errorCode;
+
+static void FuzzHeader(const uint8_t* data, size_t size) {
+
+	byte parsed[TIMESTAMPLENGTH];
+	char text[64];
+	PLIFHDR hdr;
+	FILE* stream;
+	LIFTIME t;
+
+	/* Through LoadLIF(), as -a show does */
+	if (!(stream = fmemopen((void*)data, size, "rb"))) return;
+	errorCode = 0;
+	if ((hdr = LoadLIF(stream))) {
+		GetRealFileLength(hdr);
+		ShowLIFHeader(hdr);
+
+		/* A timestamp that claims to be valid must read back the same once printed */
+		if (UnpackLIFTime(hdr->timestamp, &t)) {
+			FormatLIFTimestamp(hdr->timestamp, text);
+			if (!ParseLIFTimestamp(text, parsed) || memcmp(parsed, hdr->timestamp, TIMESTAMPLENGTH)) abort();
+		}
+		free(hdr);
+	}
+	else if (size >= HEADERLENGTH) abort();
+	fclose(stream);
+
+}
+
+static void FuzzImage(const uint8_t* data, size_t size) {
+
+	PLIFHDR entries;
+	int count, n;
+
+	if (ParseLIFDirectory(data, size, &entries, &count) != LIFIMG_OK) return;
+	if ((size_t)count * HEADERLENGTH > size) abort();
+
+	for (n = 0; n < count; ++n) {
+		long long offset = (long long)ntohl(entries[n].startSector) * BYTESPERSECTOR;
+		long long length = LIFPayloadLength(&entries[n], (long long)size - offset);
+		if (length < 0 || (length && offset + length > (long long)size)) abort();
+	}
+	free(entries);
+
+}
+
+static void FuzzStrings(const uint8_t* data, size_t size) {
+
+	byte stamp[TIMESTAMPLENGTH];
+	char* text;
+
+	if (!(text = (char*)malloc(size + 1))) return;
+	memcpy(text, data, size);
+	text[size] = 0x00;
+
+	if (ParseLIFTimestamp(text, stamp) && !ValidLIFTimestamp(stamp)) abort();
+
+	lifFileSpec = text;
+	errorCode = 0;
+	memset(lifName, 0x20, FILENAMELENGTH);
+	ParseLIFName();
+
+	lifFileSpec = NULL;
+	free(text);
+
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+
+	static int quiet = 0;
+
+	/* ShowLIFHeader() talks a lot */
+	if (!quiet) {
+		quiet = freopen("/dev/null", "w", stdout) != NULL;
+	}
+
+	FuzzHeader(data, size);
+	FuzzImage(data, size);
+	FuzzStrings(data, size);
+	return 0;
+
+}
+
+#ifdef LIFFUZZ_STANDALONE
+static int RunFile(FILE* inStream) {
+
+	uint8_t* data = NULL;
+	uint8_t* newPtr;
+	size_t size = 0, r;
+	byte sector[BYTESPERSECTOR];
+
+	while ((r = fread(sector, 1, BYTESPERSECTOR, inStream)) > 0) {
+		if (!(newPtr = (uint8_t*)realloc(data, size + r))) {
+			free(data);
+			return 1;
+		}
+		data = newPtr;
+		memcpy(data + size, sector, r);
+		size += r;
+	}
+
+	LLVMFuzzerTestOneInput(data ? data : (uint8_t*)"", size);
+	free(data);
+	return 0;
+
+}
+
+int main(int argc, char** argv) {
+
+	FILE* inStream;
+	int n;
+
+	if (argc < 2) return RunFile(stdin);
+
+	for (n = 1; n < argc; ++n) {
+		if (!(inStream = fopen(argv[n], "rb"))) {
+			fprintf(stderr, "ERROR: Could not open %s\n", argv[n]);
+			return 3;
+		}
+		RunFile(inStream);
+		fclose(inStream);
+	}
+
+	return 0;
+
+}
+#endif
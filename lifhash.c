@@ -0,0 +1,267 @@
+/* Content hashing
+ *
+ * A fast 64 bit non-cryptographic hash (XXH64) and SHA-256, both of which can
+ * be fed the data in pieces of any size.
+ *
+ * XXH64 runs four independent accumulators over each 32 byte stripe so the
+ * processor can work on all of them at once.
+ */
+
+#include "lifhash.h"
+#include <string.h>
+
+#define PRIME64_1	0x9E3779B185EBCA87ULL
+#define PRIME64_2	0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3	0x165667B19E3779F9ULL
+#define PRIME64_4	0x85EBCA77C2B2AE63ULL
+#define PRIME64_5	0x27D4EB2F165667C5ULL
+
+#define ROTL64(x, r)	(((x) << (r)) | ((x) >> (64 - (r))))
+#define ROTR32(x, r)	(((x) >> (r)) | ((x) << (32 - (r))))
+
+/* Little-endian loads, whatever the host byte order */
+static uint64_t Read64(const unsigned char* p) {
+	return (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24)
+		| ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) | ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+}
+
+static uint32_t Read32(const unsigned char* p) {
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t Round64(uint64_t acc, uint64_t input) {
+	acc += input * PRIME64_2;
+	acc = ROTL64(acc, 31);
+	return acc * PRIME64_1;
+}
+
+static uint64_t Merge64(uint64_t acc, uint64_t val) {
+	acc ^= Round64(0, val);
+	return acc * PRIME64_1 + PRIME64_4;
+}
+
+/* Consume whole 32 byte stripes and return how many bytes were used */
+static size_t Stripes64(uint64_t* acc, const unsigned char* p, size_t len) {
+
+	const unsigned char* start = p;
+	uint64_t a0 = acc[0], a1 = acc[1], a2 = acc[2], a3 = acc[3];
+
+	while (len >= 32) {
+		a0 = Round64(a0, Read64(p));
+		a1 = Round64(a1, Read64(p + 8));
+		a2 = Round64(a2, Read64(p + 16));
+		a3 = Round64(a3, Read64(p + 24));
+		p += 32;
+		len -= 32;
+	}
+
+	acc[0] = a0;
+	acc[1] = a1;
+	acc[2] = a2;
+	acc[3] = a3;
+	return p - start;
+
+}
+
+void Hash64Init(HASH64CTX* ctx, uint64_t seed) {
+	ctx->acc[0] = seed + PRIME64_1 + PRIME64_2;
+	ctx->acc[1] = seed + PRIME64_2;
+	ctx->acc[2] = seed;
+	ctx->acc[3] = seed - PRIME64_1;
+	ctx->totalLength = 0;
+	ctx->buffered = 0;
+}
+
+void Hash64Update(HASH64CTX* ctx, const void* data, size_t len) {
+
+	const unsigned char* p = (const unsigned char*)data;
+	size_t n;
+
+	ctx->totalLength += len;
+
+	/* Top up a partial stripe left over from last time */
+	if (ctx->buffered) {
+		n = 32 - ctx->buffered;
+		if (n > len) n = len;
+		memcpy(ctx->buffer + ctx->buffered, p, n);
+		ctx->buffered += n;
+		p += n;
+		len -= n;
+		if (ctx->buffered < 32) return;
+		Stripes64(ctx->acc, ctx->buffer, 32);
+		ctx->buffered = 0;
+	}
+
+	n = Stripes64(ctx->acc, p, len);
+	memcpy(ctx->buffer, p + n, len - n);
+	ctx->buffered = len - n;
+
+}
+
+uint64_t Hash64Final(HASH64CTX* ctx) {
+
+	const unsigned char* p = ctx->buffer;
+	size_t len = ctx->buffered;
+	uint64_t h;
+
+	if (ctx->totalLength >= 32) {
+		h = ROTL64(ctx->acc[0], 1) + ROTL64(ctx->acc[1], 7) + ROTL64(ctx->acc[2], 12) + ROTL64(ctx->acc[3], 18);
+		h = Merge64(h, ctx->acc[0]);
+		h = Merge64(h, ctx->acc[1]);
+		h = Merge64(h, ctx->acc[2]);
+		h = Merge64(h, ctx->acc[3]);
+	}
+	else {
+		/* acc[2] still holds the seed */
+		h = ctx->acc[2] + PRIME64_5;
+	}
+
+	h += ctx->totalLength;
+
+	while (len >= 8) {
+		h ^= Round64(0, Read64(p));
+		h = ROTL64(h, 27) * PRIME64_1 + PRIME64_4;
+		p += 8;
+		len -= 8;
+	}
+	if (len >= 4) {
+		h ^= (uint64_t)Read32(p) * PRIME64_1;
+		h = ROTL64(h, 23) * PRIME64_2 + PRIME64_3;
+		p += 4;
+		len -= 4;
+	}
+	while (len) {
+		h ^= *p * PRIME64_5;
+		h = ROTL64(h, 11) * PRIME64_1;
+		++p;
+		--len;
+	}
+
+	h ^= h >> 33;
+	h *= PRIME64_2;
+	h ^= h >> 29;
+	h *= PRIME64_3;
+	h ^= h >> 32;
+	return h;
+
+}
+
+uint64_t Hash64(const void* data, size_t len, uint64_t seed) {
+
+	HASH64CTX ctx;
+
+	Hash64Init(&ctx, seed);
+	Hash64Update(&ctx, data, len);
+	return Hash64Final(&ctx);
+
+}
+
+
+static const uint32_t sha256K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static void SHA256Block(uint32_t* state, const unsigned char* block) {
+
+	uint32_t w[64];
+	uint32_t a, b, c, d, e, f, g, h, t1, t2;
+	int n;
+
+	for (n = 0; n < 16; ++n) {
+		w[n] = ((uint32_t)block[n*4] << 24) | ((uint32_t)block[n*4+1] << 16)
+			| ((uint32_t)block[n*4+2] << 8) | (uint32_t)block[n*4+3];
+	}
+	for (n = 16; n < 64; ++n) {
+		t1 = ROTR32(w[n-2], 17) ^ ROTR32(w[n-2], 19) ^ (w[n-2] >> 10);
+		t2 = ROTR32(w[n-15], 7) ^ ROTR32(w[n-15], 18) ^ (w[n-15] >> 3);
+		w[n] = t1 + w[n-7] + t2 + w[n-16];
+	}
+
+	a = state[0]; b = state[1]; c = state[2]; d = state[3];
+	e = state[4]; f = state[5]; g = state[6]; h = state[7];
+
+	for (n = 0; n < 64; ++n) {
+		t1 = h + (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) + ((e & f) ^ (~e & g)) + sha256K[n] + w[n];
+		t2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+		h = g; g = f; f = e; e = d + t1;
+		d = c; c = b; b = a; a = t1 + t2;
+	}
+
+	state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+	state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+
+}
+
+void SHA256Init(SHA256CTX* ctx) {
+	ctx->state[0] = 0x6a09e667;
+	ctx->state[1] = 0xbb67ae85;
+	ctx->state[2] = 0x3c6ef372;
+	ctx->state[3] = 0xa54ff53a;
+	ctx->state[4] = 0x510e527f;
+	ctx->state[5] = 0x9b05688c;
+	ctx->state[6] = 0x1f83d9ab;
+	ctx->state[7] = 0x5be0cd19;
+	ctx->totalLength = 0;
+	ctx->buffered = 0;
+}
+
+void SHA256Update(SHA256CTX* ctx, const void* data, size_t len) {
+
+	const unsigned char* p = (const unsigned char*)data;
+	size_t n;
+
+	ctx->totalLength += len;
+
+	if (ctx->buffered) {
+		n = 64 - ctx->buffered;
+		if (n > len) n = len;
+		memcpy(ctx->buffer + ctx->buffered, p, n);
+		ctx->buffered += n;
+		p += n;
+		len -= n;
+		if (ctx->buffered < 64) return;
+		SHA256Block(ctx->state, ctx->buffer);
+		ctx->buffered = 0;
+	}
+
+	while (len >= 64) {
+		SHA256Block(ctx->state, p);
+		p += 64;
+		len -= 64;
+	}
+
+	memcpy(ctx->buffer, p, len);
+	ctx->buffered = len;
+
+}
+
+void SHA256Final(SHA256CTX* ctx, unsigned char* digest) {
+
+	uint64_t bits = ctx->totalLength << 3;
+	int n;
+
+	ctx->buffer[ctx->buffered++] = 0x80;
+	if (ctx->buffered > 56) {
+		memset(ctx->buffer + ctx->buffered, 0, 64 - ctx->buffered);
+		SHA256Block(ctx->state, ctx->buffer);
+		ctx->buffered = 0;
+	}
+	memset(ctx->buffer + ctx->buffered, 0, 56 - ctx->buffered);
+	for (n = 0; n < 8; ++n) ctx->buffer[56 + n] = bits >> (56 - n * 8);
+	SHA256Block(ctx->state, ctx->buffer);
+
+	for (n = 0; n < 8; ++n) {
+		digest[n*4] = ctx->state[n] >> 24;
+		digest[n*4+1] = ctx->state[n] >> 16;
+		digest[n*4+2] = ctx->state[n] >> 8;
+		digest[n*4+3] = ctx->state[n];
+	}
+
+}
@@ -0,0 +1,40 @@
+/* Content hashing
+ *
+ * A fast 64 bit non-cryptographic hash (XXH64) and SHA-256, both of which can
+ * be fed the data in pieces of any size.
+ */
+
+#ifndef LIFHASH_H
+#define LIFHASH_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#define SHA256LENGTH	32
+
+typedef struct {
+	uint64_t acc[4];
+	uint64_t totalLength;
+	unsigned char buffer[32];
+	size_t buffered;
+} HASH64CTX;
+
+typedef struct {
+	uint32_t state[8];
+	uint64_t totalLength;
+	unsigned char buffer[64];
+	size_t buffered;
+} SHA256CTX;
+
+void Hash64Init(HASH64CTX*, uint64_t);
+void Hash64Update(HASH64CTX*, const void*, size_t);
+uint64_t Hash64Final(HASH64CTX*);
+
+/* One-shot version of the above */
+uint64_t Hash64(const void*, size_t, uint64_t);
+
+void SHA256Init(SHA256CTX*);
+void SHA256Update(SHA256CTX*, const void*, size_t);
+void SHA256Final(SHA256CTX*, unsigned char*);
+
+#endif
@@ -7,12 +7,20 @@
 
 #include "lifheader.h"
 #include "liffiletype.h"
+#include "lifcatalog.h"
+#include "lifdedup.h"
+#include "lifdiff.h"
+#include "liftime.h"
+#include "lifinput.h"
 #include <stdlib.h>
+#include <limits.h>
 #include <string.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <ctype.h>
 #include <strings.h>
 #include <time.h>
+#include <errno.h>
 #include <sys/stat.h>
 
 /* Variables that define the behaviour of lifheader */
@@ -24,12 +32,23 @@ char* outputFile = NULL;
 char* fileType = NULL;
 char* action = NULL;
 char* lifFileSpec = NULL;
+char* outputFormat = NULL;
+int jobCount = 0;
+int useSHA256 = 0;
+int linkDuplicates = 0;
+int useFixedTime = 0;
+byte fixedTimestamp[TIMESTAMPLENGTH];
+char** operands = NULL;
+int operandCount = 0;
 byte sector[BYTESPERSECTOR];
+byte* inMap = NULL;
+size_t inMapSize = 0;
 char lifName[FILENAMELENGTH];
 
 FILE *inStream;
 FILE *outStream;
 
+#ifndef LIFHEADER_NOMAIN
 int main(int argc, char** argv) {
 	
 	PLIFHDR hdr;
@@ -44,6 +63,24 @@ int main(int argc, char** argv) {
 		goto alldone;
 	}
 	
+	/* Cataloguing reads any number of LIF images rather than a single input file */
+	if (!strcasecmp(action, "catalog")) {
+		DoCatalog();
+		goto alldone;
+	}
+	
+	/* So does looking for duplicates, which takes extracted files and LIF images */
+	if (!strcasecmp(action, "dedup")) {
+		DoDedup();
+		goto alldone;
+	}
+	
+	/* Comparing LIF images takes exactly two of them */
+	if (!strcasecmp(action, "diff")) {
+		DoDiff();
+		goto alldone;
+	}
+	
 	/* whatever we're doing, we'll need an input file */
 	
 	/* If there is an input file and if it is "-"... */
@@ -63,7 +100,11 @@ int main(int argc, char** argv) {
 	
 	/* Are we supposed to be displaying the header? */
 	if (!strcasecmp(action, "show")) {
-		if ((hdr = LoadLIF(inStream))) {
+		/* A regular file's header can be shown straight from the mapping */
+		if (MapInput(inStream, 0, &inMap, &inMapSize) && inMapSize >= HEADERLENGTH) {
+			ShowLIFHeader((PLIFHDR)inMap);
+		}
+		else if ((hdr = LoadLIF(inStream))) {
 			ShowLIFHeader(hdr);
 			free(hdr);
 		}
@@ -92,6 +133,19 @@ int main(int argc, char** argv) {
 	
 	/* Stripping a header? Don't ask questions, just chop off the first 32 bytes. */
 	if (!strcasecmp(action, "strip")) {
+		/* A regular file goes out in one go, straight from the mapping */
+		if (MapInput(inStream, 1, &inMap, &inMapSize)) {
+			if (inMapSize < HEADERLENGTH) {
+				fprintf(stderr, "ERROR: Could not read from input\n");
+				errorCode = 4;
+			}
+			else if (!WriteOut(outStream, NULL, 0, inMap + HEADERLENGTH, inMapSize - HEADERLENGTH)) {
+				fprintf(stderr, "ERROR: Unable to write to output.\n");
+				errorCode = 11;
+			}
+			goto alldone;
+		}
+		
 		/* Is the file at least 32 bytes long? Reading a header will tell us this. */
 		if (!(hdr = LoadLIF(inStream))) goto alldone;
 		
@@ -117,6 +171,16 @@ int main(int argc, char** argv) {
 		/* Bail out if there was an error parsing the LIF filename */
 		if (errorCode) goto alldone;
 		
+		/* Reproducible builds set SOURCE_DATE_EPOCH, unless the command line said otherwise */
+		char* epoch;
+		if (!useFixedTime && (epoch = getenv("SOURCE_DATE_EPOCH"))) {
+			if (!SetSourceDateEpoch(epoch)) {
+				fprintf(stderr, "ERROR: Invalid SOURCE_DATE_EPOCH: %s\n", epoch);
+				errorCode = 17;
+				goto alldone;
+			}
+		}
+		
 		/* Do we have the file type to use? */
 		if (!fileType) {
 			fprintf(stderr, "ERROR: file type not given (-t option)\n");
@@ -137,11 +201,17 @@ int main(int argc, char** argv) {
 		hdr->fileType = htons(lifID);
 		memcpy(hdr->fileName, lifName, FILENAMELENGTH);
 		
-		/* Start reading the source file into memory and keep track of its length */
+		/* A regular file is already in memory once it's mapped... */
 		uint32_t dataSize = 0;
-		byte* inData;
+		byte* inData = NULL;
 		byte* newPtr;
-		size_t bytesRead = 1;
+		size_t bytesRead = MapInput(inStream, 1, &inMap, &inMapSize) ? 0 : 1;
+		if (inMap) {
+			inData = inMap;
+			dataSize = inMapSize;
+		}
+		
+		/* ... otherwise start reading the source file into memory and keep track of its length */
 		while (bytesRead > 0) {
 			bytesRead = fread(sector, sizeof(byte), BYTESPERSECTOR, inStream);
 			if (bytesRead >= 1) {
@@ -174,49 +244,37 @@ int main(int argc, char** argv) {
 		hdr->fileSize = htonl(nbSectors);
 		SetLIFSize(hdr, dataSize);
 		
-		/* Now for the timestamp. Are we using the current timestamp for this? */
-		time_t useThisTime;
-		struct stat statbuf;
-		if (useToday) {
-			useThisTime = time(NULL);
+		/* Now for the timestamp. Was one forced on us? */
+		if (useFixedTime) {
+			memcpy(hdr->timestamp, fixedTimestamp, TIMESTAMPLENGTH);
 		}
 		else {
-			if (fstat(fileno(inStream), &statbuf)) {
+			/* Are we using the current timestamp for this? */
+			time_t useThisTime;
+			struct stat statbuf;
+			if (useToday) {
 				useThisTime = time(NULL);
 			}
 			else {
-				useThisTime = statbuf.st_mtime;
+				if (fstat(fileno(inStream), &statbuf)) {
+					useThisTime = time(NULL);
+				}
+				else {
+					useThisTime = statbuf.st_mtime;
+				}
 			}
+			
+			LocalLIFTimestamp(useThisTime, hdr->timestamp);
 		}
 		
-		struct tm timestruct;
-		localtime_r(&useThisTime, &timestruct);
-		
-		/* Fill in the blanks */
-		hdr->timestamp[0] = int2BCD(timestruct.tm_year % 100);
-		hdr->timestamp[1] = int2BCD(timestruct.tm_mon + 1);
-		hdr->timestamp[2] = int2BCD(timestruct.tm_mday);
-		hdr->timestamp[3] = int2BCD(timestruct.tm_hour);
-		hdr->timestamp[4] = int2BCD(timestruct.tm_min);
-		hdr->timestamp[5] = int2BCD(timestruct.tm_sec);
-		
-		/* We're done! Write the data */
-		if (fwrite(hdr, sizeof(LIFHDR), 1, outStream) != 1)
-		{
-			fprintf(stderr, "ERROR: Unable to write to output.\n");
-			errorCode = 11;
-			free(hdr);
-			free(inData);
-			goto alldone;
-		}
-		
-		if (fwrite(inData, sizeof(byte), dataSize, outStream) != dataSize) {
+		/* We're done! Write the header and the data together */
+		if (!WriteOut(outStream, hdr, sizeof(LIFHDR), inData, dataSize)) {
 			fprintf(stderr, "ERROR: Unable to write to output.\n");
 			errorCode = 11;
 		}
 		
 		free(hdr);
-		free(inData);
+		if (!inMap) free(inData);
 		
 		goto alldone;
 	}
@@ -225,9 +283,11 @@ int main(int argc, char** argv) {
 	errorCode = 6;
 
 alldone:
+	UnmapInput(inMap, inMapSize);
 	return errorCode;
 	
 }
+#endif
 
 
 /* Read in a LIF header from a file */
@@ -248,15 +308,179 @@ PLIFHDR LoadLIF(FILE* inStream) {
 	
 }
 
+/* Gather the files given with -i and as extra arguments, expanding directories,
+ * and open the output for a report on them */
+char** ListInputFiles(int* nFiles) {
+	
+	char** files;
+	char** paths;
+	int nPaths = 0;
+	
+	/* The -i file, if any, goes first and the remaining arguments follow */
+	if (!(paths = (char**)malloc((operandCount + 1) * sizeof(char*)))) {
+		fprintf(stderr, "ERROR: Out of memory listing input files.\n");
+		errorCode = 13;
+		return NULL;
+	}
+	if (inputFile) paths[nPaths++] = inputFile;
+	memcpy(paths + nPaths, operands, operandCount * sizeof(char*));
+	nPaths += operandCount;
+	
+	if (!nPaths) {
+		fprintf(stderr, "ERROR: No input files given\n");
+		errorCode = 16;
+		free(paths);
+		return NULL;
+	}
+	
+	files = ExpandImageList(paths, nPaths, nFiles);
+	free(paths);
+	if (!files) {
+		fprintf(stderr, "ERROR: Out of memory listing input files.\n");
+		errorCode = 13;
+		return NULL;
+	}
+	
+	if (!OpenReportOutput()) {
+		FreeImageList(files, *nFiles);
+		return NULL;
+	}
+	
+	return files;
+	
+}
+
+/* Open the output for the reports, which unlike binary files may go to STDOUT everywhere */
+int OpenReportOutput() {
+	
+	if (outputFile && !strcmp(outputFile, "-")) outputFile = NULL;
+	if (outputFile) {
+		if (!(outStream = fopen(outputFile, "wb"))) {
+			fprintf(stderr, "ERROR: Could not open output file\n");
+			errorCode = 5;
+			return 0;
+		}
+	}
+	else {
+#ifdef __WIN32
+		outStream = freopen(NULL, "wb", stdout);
+#else
+		outStream = stdout;
+#endif
+	}
+	
+	return 1;
+	
+}
+
+/* Build a catalog of the LIF images given with -i and as extra arguments */
+void DoCatalog() {
+	
+	char** images;
+	int nImages, format;
+	
+	if (!outputFormat || !strcasecmp(outputFormat, "jsonl")) format = CATALOG_JSONL;
+	else if (!strcasecmp(outputFormat, "bin")) format = CATALOG_BINARY;
+	else {
+		fprintf(stderr, "ERROR: Unknown output format: %s\n", outputFormat);
+		errorCode = 15;
+		return;
+	}
+	
+	if (!(images = ListInputFiles(&nImages))) return;
+	
+	errorCode = CatalogImages(images, nImages, outStream, format, jobCount);
+	FreeImageList(images, nImages);
+	
+	if (fflush(outStream)) {
+		fprintf(stderr, "ERROR: Unable to write to output.\n");
+		errorCode = 11;
+	}
+	
+}
+
+/* Look for files with the same contents among extracted files and LIF images */
+void DoDedup() {
+	
+	char** files;
+	int nFiles;
+	
+	if (!(files = ListInputFiles(&nFiles))) return;
+	
+	errorCode = DedupFiles(files, nFiles, outStream, useSHA256, linkDuplicates, jobCount);
+	FreeImageList(files, nFiles);
+	
+	if (fflush(outStream)) {
+		fprintf(stderr, "ERROR: Unable to write to output.\n");
+		errorCode = 11;
+	}
+	
+}
+
+/* Compare two LIF images, given with -i and as an extra argument or both as extra arguments */
+void DoDiff() {
+	
+	char* images[2];
+	int nImages = 0, n;
+	
+	if (inputFile) images[nImages++] = inputFile;
+	for (n = 0; n < operandCount && nImages <= 2; ++n) {
+		if (nImages < 2) images[nImages] = operands[n];
+		++nImages;
+	}
+	
+	if (nImages != 2) {
+		fprintf(stderr, "ERROR: -a diff needs exactly two LIF images\n");
+		errorCode = 16;
+		return;
+	}
+	
+	if (!OpenReportOutput()) return;
+	
+	errorCode = DiffImages(images[0], images[1], outStream);
+	
+	if (fflush(outStream)) {
+		fprintf(stderr, "ERROR: Unable to write to output.\n");
+		errorCode = 11;
+	}
+	
+}
+
+/* Take a time in seconds since the epoch for all the timestamps, in UTC as
+ * reproducible builds expect */
+int SetSourceDateEpoch(const char* epoch) {
+	
+	char* end;
+	long long seconds;
+	
+	errno = 0;
+	seconds = strtoll(epoch, &end, 10);
+	if (!*epoch || *end || errno == ERANGE) return 0;
+	
+	/* Only the 100 years from FIRSTYEAR fit in a LIF timestamp; don't wrap round */
+	if (seconds < 0 || seconds >= LASTEPOCH) return 0;
+	
+	UTCLIFTimestamp((time_t)seconds, fixedTimestamp);
+	useFixedTime = ValidLIFTimestamp(fixedTimestamp);
+	return useFixedTime;
+	
+}
+
 /* Parse the command line to find out what we have to do */
 void parseCommandLine(int argc, char** argv) {
 	
 	int c; /* will be -1 when we run out of options */
 	int l; /* lower case version of c */
 	
-	while ((c = getopt(argc, argv, "i:o:t:a:l:h")) != -1) {
+	static struct option longOptions[] = {
+		{ "timestamp", required_argument, NULL, OPT_TIMESTAMP },
+		{ "source-date-epoch", required_argument, NULL, OPT_SOURCEDATEEPOCH },
+		{ NULL, 0, NULL, 0 }
+	};
+	
+	while ((c = getopt_long(argc, argv, "i:o:t:a:l:f:j:skh", longOptions, NULL)) != -1) {
 		
-		l = tolower(c);
+		l = (c < OPT_TIMESTAMP) ? tolower(c) : c;
 		switch (l) {
 			
 			case 'i':
@@ -283,6 +507,38 @@ void parseCommandLine(int argc, char** argv) {
 				lifFileSpec = optarg;
 				break;
 			
+			case 'f':
+				outputFormat = optarg;
+				break;
+			
+			case 'j':
+				jobCount = atoi(optarg);
+				break;
+			
+			case 's':
+				useSHA256 = 1;
+				break;
+			
+			case 'k':
+				linkDuplicates = 1;
+				break;
+			
+			case OPT_TIMESTAMP:
+				if (!(useFixedTime = ParseLIFTimestamp(optarg, fixedTimestamp))) {
+					fprintf(stderr, "ERROR: Invalid timestamp: %s\n", optarg);
+					errorCode = 17;
+					return;
+				}
+				break;
+			
+			case OPT_SOURCEDATEEPOCH:
+				if (!SetSourceDateEpoch(optarg)) {
+					fprintf(stderr, "ERROR: Invalid source date epoch: %s\n", optarg);
+					errorCode = 17;
+					return;
+				}
+				break;
+			
 			case '?':
 				errorCode = 1;
 				return;
@@ -291,6 +547,10 @@ void parseCommandLine(int argc, char** argv) {
 		
 	}
 	
+	/* Anything left over is a list of files or LIF images to work on */
+	operands = argv + optind;
+	operandCount = argc - optind;
+	
 	/* Check that the action was given */
 	if (!action) {
 		fprintf(stderr, "ERROR: No action given. Cannot continue.\n");
@@ -343,8 +603,8 @@ void ShowLIFHeader(PLIFHDR hdr) {
 	uint32_t nSectors = ntohl(hdr->fileSize);
 	uint32_t nBytes = nSectors * BYTESPERSECTOR;
 	int usedBytes = GetRealFileLength(hdr);
-	int yr = 1900 + BCD2int((int)hdr->timestamp[0]);
-	if (yr < 1970) yr += 100;
+	char stamp[TIMESTAMPTEXTLENGTH];
+	FormatLIFTimestamp(hdr->timestamp, stamp);
 	uint16_t lifType = ntohs(hdr->fileType);
 	fileType = lifDescriptionFromID(lifType);
 	
@@ -352,14 +612,7 @@ void ShowLIFHeader(PLIFHDR hdr) {
 	printf("File type:    0x%04x (%s)\n", lifType, fileType ? fileType : "unknown");
 	printf("Start sector: %u\n", (unsigned)ntohl(hdr->startSector));
 	printf("File length:  %u sectors (%u bytes), %d bytes used\n", nSectors, nBytes, usedBytes);
-	printf("Timestamp:    %d-%02d-%02d %02d:%02d:%02d\n",
-		yr,
-		BCD2int((int)hdr->timestamp[1]),
-		BCD2int((int)hdr->timestamp[2]),
-		BCD2int((int)hdr->timestamp[3]),
-		BCD2int((int)hdr->timestamp[4]),
-		BCD2int((int)hdr->timestamp[5])
-	);
+	printf("Timestamp:    %s%s\n", stamp, ValidLIFTimestamp(hdr->timestamp) ? "" : " (invalid)");
 	printf("Volume ID:    0x%04x\n", (int)ntohs(hdr->volumeID));
 	printf("Gen. Purpose: 0x%08x\n\n", (unsigned)ntohl(hdr->generalPurpose));
 	
@@ -369,13 +622,21 @@ void ShowLIFHeader(PLIFHDR hdr) {
 void ShowUsage() {
 	printf("Usage:\n");
 	printf("\tlifheader { -a action | -h } [ -i input_file ] [ -o output_file ] [ -t file_type ]\n");
-	printf("\t          [ -l lif_file_name ]\n\n");
+	printf("\t          [ -l lif_file_name ] [ -f format ] [ -j jobs ] [ -s ] [ -k ]\n");
+	printf("\t          [ --timestamp date_time | --source-date-epoch seconds ] [ file ... ]\n\n");
 	printf("\t-h                Shows this help message.\n\n");
 	printf("\t-a action         Specifies the action to undertake on the input file. Possible options are:\n");
 	printf("\t\t-a strip        Strips the LIF header from the input file.\n");
 	printf("\t\t-a add          Generates a LIF header, prepends it to the input file\n");
 	printf("\t\t                and saves the result to the output file\n");
-	printf("\t\t-a show         Shows the data in the LIF header.\n\n");
+	printf("\t\t-a show         Shows the data in the LIF header.\n");
+	printf("\t\t-a catalog      Lists the directories of all the LIF images given with -i\n");
+	printf("\t\t                and as extra arguments. Directories are searched for images.\n");
+	printf("\t\t-a dedup        Lists groups of files with the same contents, LIF headers aside,\n");
+	printf("\t\t                among the extracted files and LIF images given with -i and\n");
+	printf("\t\t                as extra arguments. Directories are searched for files.\n");
+	printf("\t\t-a diff         Lists the files added, removed or modified between two\n");
+	printf("\t\t                LIF images given with -i and as extra arguments.\n\n");
 	printf("\t-i input_file     Designates the input file to read from. If not given\n");
 	printf("\t                  or if the string `-' is given, then STDIN is used.\n\n");
 #ifdef __WIN32
@@ -401,12 +662,28 @@ void ShowUsage() {
 	printf("\t-l lif_file_name  Provides the name for the file in the LIF image when adding a\n");
 	printf("\t                  LIF header to a file. The name is deduced from the original\n");
 	printf("\t                  filename if not given on the command line.\n\n");
+	printf("\t-f format         Output format for -a catalog. Possible options are:\n");
+	printf("\t\t-f jsonl        One JSON object per directory entry (default)\n");
+	printf("\t\t-f bin          Compact binary catalog\n\n");
+	printf("\t-j jobs           Number of files to read in parallel for -a catalog and -a dedup.\n");
+	printf("\t                  Defaults to the number of processors.\n\n");
+	printf("\t-s                With -a dedup, also compare SHA-256 digests of the contents.\n\n");
+	printf("\t-k                With -a dedup, replace duplicate extracted files that are\n");
+	printf("\t                  identical, headers included, by hard links to the first one.\n\n");
+	printf("\t--timestamp date_time\n");
+	printf("\t                  When adding a LIF header, use this timestamp, given as\n");
+	printf("\t                  \"YYYY-MM-DD hh:mm:ss\", instead of the file's date and time.\n\n");
+	printf("\t--source-date-epoch seconds\n");
+	printf("\t                  When adding a LIF header, use this time in seconds since\n");
+	printf("\t                  1970-01-01 00:00:00 UTC as the timestamp, in UTC. The\n");
+	printf("\t                  SOURCE_DATE_EPOCH environment variable does the same.\n\n");
 }
 
 /* Get the actual file length */
 int GetRealFileLength(PLIFHDR hdr) {
 	
 	int nbRecords, recordLength;
+	long long length;
 	byte* ptr;
 	
 	/* This is going to depend on the file type */
@@ -416,7 +693,8 @@ int GetRealFileLength(PLIFHDR hdr) {
 		
 		case 1:			/* text file */
 		case 0xe0d1:	/* secure text file */
-			return BYTESPERSECTOR * ntohl(hdr->fileSize);
+			length = (long long)BYTESPERSECTOR * ntohl(hdr->fileSize);
+			return length > INT_MAX ? INT_MAX : (int)length;
 		
 		case 0x00ff:	/* disabled LEX file */
 			return HP71Length(hdr);
@@ -429,7 +707,9 @@ int GetRealFileLength(PLIFHDR hdr) {
 			ptr = (byte*)&(hdr->generalPurpose);
 			nbRecords = *ptr + *(ptr+1) * 256;
 			recordLength = *(ptr+2) + *(ptr+3) * 256;
-			return nbRecords * recordLength;
+			/* Up to 65535 * 65535 bytes, more than an int holds */
+			length = (long long)nbRecords * recordLength;
+			return length > INT_MAX ? INT_MAX : (int)length;
 		
 		case 0xe204:	/* BIN file */
 		case 0xe205:	/* secure BIN file */
@@ -451,7 +731,8 @@ int GetRealFileLength(PLIFHDR hdr) {
 		case 0xe219:	/* secure FRAM file */
 		case 0xe21a:	/* private FRAM file */
 		case 0xe21b:	/* private, secure FRAM file */
-			return BYTESPERSECTOR * ntohl(hdr->fileSize);
+			length = (long long)BYTESPERSECTOR * ntohl(hdr->fileSize);
+			return length > INT_MAX ? INT_MAX : (int)length;
 		
 		case 0xe21c:	/* ROM file */
 		case 0xe222:	/* Graphics file */
@@ -492,10 +773,21 @@ void SetLIFSize(PLIFHDR hdr, uint32_t nbBytes) {
 	switch (fileType) {
 		
 		case 0xe204:	/* BIN71 file */
+		case 0xe205:	/* secure BIN71 file */
+		case 0xe206:	/* private BIN71 file */
+		case 0xe207:	/* private, secure BIN71 file */
 		case 0xe208:	/* LEX71 file */
+		case 0xe209:	/* secure LEX71 file */
+		case 0xe20a:	/* private LEX71 file */
+		case 0xe20b:	/* private, secure LEX71 file */
 		case 0xe20c:	/* KEY71 file */
+		case 0xe20d:	/* secure KEY71 file */
 		case 0xe214:	/* BAS71 file */
+		case 0xe215:	/* secure BAS71 file */
+		case 0xe216:	/* private BAS71 file */
+		case 0xe217:	/* private, secure BAS71 file */
 		case 0xe21c:	/* ROM71 file */
+		case 0xe222:	/* Graphics file */
 			*ptr = nybbles & 0xff;
 			*(ptr+1) = (nybbles >> 8) & 0xff;
 			*(ptr+2) = (nybbles >> 16) & 0xff;
@@ -503,7 +795,7 @@ void SetLIFSize(PLIFHDR hdr, uint32_t nbBytes) {
 			break;
 		
 		case 0xe0d0:	/* HP-71B SDATA or HP-41C DATA */
-			hdr->generalPurpose = htonl((nbBytes >> 3) << 13); /* divided by 8 and shifted 13 bits leftwards */
+			hdr->generalPurpose = htonl((nbBytes >> 3) << 16); /* number of 8 byte registers in the top 16 bits */
 			break;
 		
 		case 0xe040:	/* WALL */
@@ -14,6 +14,13 @@ typedef unsigned char byte;
 #define BYTESPERSECTOR	256
 #define FILENAMELENGTH	10
 
+/* Room for a formatted timestamp, even one whose bytes are not BCD (up to 165 each) */
+#define TIMESTAMPTEXTLENGTH	32
+
+/* Long options have no short equivalent */
+#define OPT_TIMESTAMP		0x100
+#define OPT_SOURCEDATEEPOCH	0x101
+
 #ifdef __WIN32
 #include <winsock.h>
 #include <stdint.h>
@@ -43,12 +50,30 @@ int int2BCD(int);
 /* Parse the command line */
 void parseCommandLine(int, char**);
 
+/* Use a time in seconds since the epoch for the timestamps */
+int SetSourceDateEpoch(const char*);
+
 /* Create a new LIF header and initialise its fields */
 PLIFHDR NewLIFHeader();
 
 /* Show the contents of a file's LIF header */
 void ShowLIFHeader(PLIFHDR);
 
+/* Gather the input files for -a catalog and -a dedup and open the output */
+char** ListInputFiles(int*);
+
+/* Open the output for -a catalog, -a dedup and -a diff */
+int OpenReportOutput();
+
+/* Build a catalog of many LIF images */
+void DoCatalog();
+
+/* Look for files with the same contents */
+void DoDedup();
+
+/* Compare two LIF images */
+void DoDiff();
+
 /* Show the command line usage */
 void ShowUsage();
 
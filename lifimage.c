@@ -0,0 +1,229 @@
+/* LIF disk image access
+ *
+ * Reads the volume header and the directory of a LIF disk image without
+ * touching the file data, and maps whole images into memory.
+ */
+
+#include "lifimage.h"
+#include "liffiletype.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifndef __WIN32
+#include <sys/mman.h>
+#endif
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+/* Read len bytes at offset off, retrying short reads */
+long ReadAt(int fd, void* buf, size_t len, long long off) {
+
+	size_t done = 0;
+	long r;
+
+	while (done < len) {
+#ifdef __WIN32
+		/* No pread() on MinGW. Each caller owns its descriptor so seeking is safe here. */
+		if (lseek(fd, (off_t)(off + done), SEEK_SET) < 0) return -1;
+		r = read(fd, (byte*)buf + done, len - done);
+#else
+		r = pread(fd, (byte*)buf + done, len - done, (off_t)(off + done));
+#endif
+		if (r < 0) return -1;
+		if (r == 0) break;
+		done += r;
+	}
+
+	return (long)done;
+
+}
+
+/* Keep only the live entries of a directory, which have the same layout as a
+ * LIF header, and hand the buffer over to the caller */
+static int CompactDirectory(byte* dir, long dirBytes, PLIFHDR* entries, int* count) {
+
+	PLIFHDR list = (PLIFHDR)dir;
+	int n, nEntries, nLive = 0;
+
+	/* Only whole entries are of any use if the image is truncated */
+	nEntries = dirBytes / HEADERLENGTH;
+
+	for (n = 0; n < nEntries; ++n) {
+		uint16_t type = ntohs(list[n].fileType);
+		if (type == LIF_ENDOFDIR) break;
+		if (type == LIF_PURGED) continue;
+		if (n != nLive) memcpy(&list[nLive], &list[n], HEADERLENGTH);
+		++nLive;
+	}
+
+	if (!nLive) {
+		free(dir);
+		return LIFIMG_OK;
+	}
+
+	*entries = list;
+	*count = nLive;
+	return LIFIMG_OK;
+
+}
+
+/* Where the directory is and how much of it is really in an image of the given size */
+static long DirectoryExtent(PLIFVOL vol, long long imageSize, long long* dirOffset) {
+
+	long long dirBytes = (long long)ntohl(vol->dirLength) * BYTESPERSECTOR;
+
+	*dirOffset = (long long)ntohl(vol->dirStart) * BYTESPERSECTOR;
+	if (*dirOffset >= imageSize) return 0;
+	if (dirBytes > imageSize - *dirOffset) dirBytes = imageSize - *dirOffset;
+	return (long)dirBytes;
+
+}
+
+/* Read the volume header and then the whole directory in a single read */
+int ReadLIFDirectory(int fd, PLIFHDR* entries, int* count) {
+
+	byte volSector[BYTESPERSECTOR];
+	struct stat statbuf;
+	long long dirOffset;
+	byte* dir;
+	long dirBytes, r;
+
+	*entries = NULL;
+	*count = 0;
+
+	/* Too short to hold a volume header is as good as not being a LIF volume at all */
+	if ((r = ReadAt(fd, volSector, BYTESPERSECTOR, 0)) < 0 || fstat(fd, &statbuf)) return LIFIMG_IOERR;
+	if (r != BYTESPERSECTOR || ntohs(((PLIFVOL)volSector)->lifID) != LIFVOLUMEID) return LIFIMG_NOTLIF;
+
+	/* An empty directory is legal, if unusual */
+	if (!(dirBytes = DirectoryExtent((PLIFVOL)volSector, statbuf.st_size, &dirOffset))) return LIFIMG_OK;
+
+	if (!(dir = (byte*)malloc(dirBytes))) return LIFIMG_NOMEM;
+
+	if ((r = ReadAt(fd, dir, dirBytes, dirOffset)) < 0) {
+		free(dir);
+		return LIFIMG_IOERR;
+	}
+
+	return CompactDirectory(dir, r, entries, count);
+
+}
+
+/* Same as ReadLIFDirectory() but for an image that is already in memory */
+int ParseLIFDirectory(const byte* image, size_t size, PLIFHDR* entries, int* count) {
+
+	long long dirOffset;
+	byte* dir;
+	long dirBytes;
+
+	*entries = NULL;
+	*count = 0;
+
+	if (size < BYTESPERSECTOR || ntohs(((PLIFVOL)image)->lifID) != LIFVOLUMEID) return LIFIMG_NOTLIF;
+
+	if (!(dirBytes = DirectoryExtent((PLIFVOL)image, size, &dirOffset))) return LIFIMG_OK;
+
+	if (!(dir = (byte*)malloc(dirBytes))) return LIFIMG_NOMEM;
+	memcpy(dir, image + dirOffset, dirBytes);
+
+	return CompactDirectory(dir, dirBytes, entries, count);
+
+}
+
+/* Useful length of a file, never more than the sectors it occupies nor what is really there */
+long long LIFPayloadLength(PLIFHDR hdr, long long available) {
+
+	long long length = GetRealFileLength(hdr);
+	long long allocated = (long long)ntohl(hdr->fileSize) * BYTESPERSECTOR;
+
+	if (length < 0 || length > allocated) length = allocated;
+	if (length > available) length = available;
+	if (length < 0) length = 0;
+	return length;
+
+}
+
+/* An extracted file's header has to say it's volume 1 of 1 and have a proper
+ * name, and either be of a known type or occupy the sectors the data fills */
+int PlausibleLIFHeader(PLIFHDR hdr, long long available) {
+
+	long long sectors = (available + BYTESPERSECTOR - 1) / BYTESPERSECTOR;
+
+	if (ntohs(hdr->volumeID) != LIFFILEVOLUME) return 0;
+	if (hdr->fileName[0] < 'A' || hdr->fileName[0] > 'Z') return 0;
+	return lifDescriptionFromID(ntohs(hdr->fileType)) || ntohl(hdr->fileSize) == sectors;
+
+}
+
+/* Map a whole file into memory, read only */
+int MapFile(const char* path, byte** data, size_t* size) {
+
+	struct stat statbuf;
+	int fd, result = LIFIMG_OK;
+
+	*data = NULL;
+	*size = 0;
+
+	if ((fd = open(path, O_RDONLY | O_BINARY)) < 0) return LIFIMG_IOERR;
+	if (fstat(fd, &statbuf)) {
+		close(fd);
+		return LIFIMG_IOERR;
+	}
+
+	/* Nothing to map, which is fine as long as nobody looks */
+	if (!statbuf.st_size) {
+		close(fd);
+		return LIFIMG_OK;
+	}
+
+#ifdef __WIN32
+	if (!(*data = (byte*)malloc(statbuf.st_size))) result = LIFIMG_NOMEM;
+	else if (ReadAt(fd, *data, statbuf.st_size, 0) != (long)statbuf.st_size) {
+		free(*data);
+		*data = NULL;
+		result = LIFIMG_IOERR;
+	}
+#else
+	*data = (byte*)mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (*data == (byte*)MAP_FAILED) {
+		*data = NULL;
+		result = LIFIMG_IOERR;
+	}
+#endif
+
+	if (*data) *size = statbuf.st_size;
+	close(fd);
+	return result;
+
+}
+
+void UnmapFile(byte* data, size_t size) {
+
+	if (!data) return;
+#ifdef __WIN32
+	(void)size;
+	free(data);
+#else
+	munmap(data, size);
+#endif
+
+}
+
+/* Describe a result code of ReadLIFDirectory() */
+const char* LIFImageError(int code) {
+
+	switch (code) {
+		case LIFIMG_OK:		return "no error";
+		case LIFIMG_IOERR:	return "could not read the image";
+		case LIFIMG_NOTLIF:	return "not a LIF volume";
+		case LIFIMG_NOMEM:	return "out of memory";
+	}
+
+	return "unknown error";
+
+}
@@ -0,0 +1,59 @@
+/* LIF disk image access
+ *
+ * Reads the volume header and the directory of a LIF disk image without
+ * touching the file data, and maps whole images into memory.
+ */
+
+#ifndef LIFIMAGE_H
+#define LIFIMAGE_H
+
+#include "lifheader.h"
+
+#define LIFVOLUMEID		0x8000	/* first two bytes of every LIF volume */
+#define LIF_ENDOFDIR	0xffff	/* file type marking the end of the directory */
+#define LIF_PURGED		0x0000	/* file type of a purged directory entry */
+#define LIFFILEVOLUME	0x8001	/* volume number in the header of an extracted file */
+
+/* Results returned by ReadLIFDirectory() */
+#define LIFIMG_OK		0
+#define LIFIMG_IOERR	1	/* could not read the image */
+#define LIFIMG_NOTLIF	2	/* the volume header does not describe a LIF volume */
+#define LIFIMG_NOMEM	3	/* out of memory */
+
+/* Layout of the start of sector 0 of a LIF volume */
+typedef struct {
+	uint16_t lifID;
+	char volumeLabel[6];
+	uint32_t dirStart;
+	uint16_t system3000;
+	uint16_t reserved1;
+	uint32_t dirLength;
+	uint16_t version;
+	uint16_t reserved2;
+} LIFVOL, *PLIFVOL;
+
+/* Read len bytes at offset off, retrying short reads. Returns the number of bytes read or -1. */
+long ReadAt(int, void*, size_t, long long);
+
+/* Read the live (non-purged) directory entries of a LIF image into a freshly allocated array */
+int ReadLIFDirectory(int, PLIFHDR*, int*);
+
+/* Same as ReadLIFDirectory() but for an image that is already in memory */
+int ParseLIFDirectory(const byte*, size_t, PLIFHDR*, int*);
+
+/* Useful length of a file, clamped to its sectors and to the bytes available */
+long long LIFPayloadLength(PLIFHDR, long long);
+
+/* Does the header at the start of a file, with the given number of bytes after it, look real? */
+int PlausibleLIFHeader(PLIFHDR, long long);
+
+/* Map a whole file into memory, read only. Empty files give a NULL mapping. */
+int MapFile(const char*, byte**, size_t*);
+
+/* Release a mapping made by MapFile() */
+void UnmapFile(byte*, size_t);
+
+/* Describe a result code of ReadLIFDirectory() */
+const char* LIFImageError(int);
+
+#endif
@@ -0,0 +1,102 @@
+/* Memory-mapped input
+ *
+ * Regular input files are mapped into memory so that their contents can be
+ * written out again straight from the mapping. STDIN, pipes and terminals,
+ * and systems without mmap(), keep using stdio.
+ */
+
+#include "lifinput.h"
+#include <unistd.h>
+#include <sys/stat.h>
+#ifndef __WIN32
+#include <sys/mman.h>
+#include <sys/uio.h>
+#endif
+
+/* Map an input stream if it is a non-empty regular file, other than STDIN, read from the start */
+int MapInput(FILE* inStream, int sequential, byte** data, size_t* size) {
+
+#ifdef __WIN32
+	(void)inStream;
+	(void)sequential;
+	*data = NULL;
+	*size = 0;
+	return 0;
+#else
+	struct stat statbuf;
+	void* map;
+
+	*data = NULL;
+	*size = 0;
+
+	/* STDIN is read as before, whatever it is. The mapping always starts at the
+	 * beginning of the file, so neither can a stream that has been read from. */
+	if (inStream == stdin || ftell(inStream) != 0) return 0;
+	if (fstat(fileno(inStream), &statbuf) || !S_ISREG(statbuf.st_mode) || !statbuf.st_size) return 0;
+
+	map = mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fileno(inStream), 0);
+	if (map == MAP_FAILED) return 0;
+
+	/* We'll be reading it once from start to finish */
+	if (sequential) madvise(map, statbuf.st_size, MADV_SEQUENTIAL);
+
+	*data = (byte*)map;
+	*size = statbuf.st_size;
+	return 1;
+#endif
+
+}
+
+void UnmapInput(byte* data, size_t size) {
+
+#ifndef __WIN32
+	if (data) munmap(data, size);
+#else
+	(void)data;
+	(void)size;
+#endif
+
+}
+
+/* Write a header and the data after it, in a single writev() where possible */
+int WriteOut(FILE* outStream, const void* header, size_t headerLength, const void* data, size_t length) {
+
+#ifdef __WIN32
+	if (headerLength && fwrite(header, 1, headerLength, outStream) != headerLength) return 0;
+	return !length || fwrite(data, 1, length, outStream) == length;
+#else
+	struct iovec iov[2];
+	int fd = fileno(outStream);
+	long r;
+	int n = 0;
+
+	/* Anything already sitting in the stream's buffer must go first */
+	if (fflush(outStream)) return 0;
+
+	if (headerLength) {
+		iov[n].iov_base = (void*)header;
+		iov[n++].iov_len = headerLength;
+	}
+	if (length) {
+		iov[n].iov_base = (void*)data;
+		iov[n++].iov_len = length;
+	}
+
+	/* Carry on after a short write until everything is out */
+	while (n) {
+		if ((r = writev(fd, iov, n)) < 0) return 0;
+		while (n && (size_t)r >= iov[0].iov_len) {
+			r -= iov[0].iov_len;
+			iov[0] = iov[1];
+			--n;
+		}
+		if (n) {
+			iov[0].iov_base = (byte*)iov[0].iov_base + r;
+			iov[0].iov_len -= r;
+		}
+	}
+
+	return 1;
+#endif
+
+}
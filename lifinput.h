@@ -0,0 +1,22 @@
+/* Memory-mapped input
+ *
+ * Regular input files are mapped into memory so that their contents can be
+ * written out again straight from the mapping. STDIN, pipes and terminals,
+ * and systems without mmap(), keep using stdio.
+ */
+
+#ifndef LIFINPUT_H
+#define LIFINPUT_H
+
+#include "lifheader.h"
+
+/* Map an input stream if it is a non-empty regular file, other than STDIN, read from the start. Returns 1 if it was mapped. */
+int MapInput(FILE*, int, byte**, size_t*);
+
+/* Release a mapping made by MapInput() */
+void UnmapInput(byte*, size_t);
+
+/* Write a header and the data after it with as few system calls as possible. Returns 0 on failure. */
+int WriteOut(FILE*, const void*, size_t, const void*, size_t);
+
+#endif
@@ -0,0 +1,196 @@
+/* LIF timestamps
+ *
+ * BCD bytes are packed and unpacked through lookup tables. UTC times are
+ * broken down without going through the C library's time zone handling.
+ */
+
+#include "liftime.h"
+#include <stdio.h>
+#include <string.h>
+
+#define SECONDSPERDAY	86400L
+
+/* BCD byte to its value, hi * 10 + lo, the same as BCD2int() even for non-BCD bytes */
+#define DECODEROW(h) \
+	h*10+0, h*10+1, h*10+2, h*10+3, h*10+4, h*10+5, h*10+6, h*10+7, \
+	h*10+8, h*10+9, h*10+10, h*10+11, h*10+12, h*10+13, h*10+14, h*10+15
+
+static const byte bcdDecode[256] = {
+	DECODEROW(0), DECODEROW(1), DECODEROW(2), DECODEROW(3),
+	DECODEROW(4), DECODEROW(5), DECODEROW(6), DECODEROW(7),
+	DECODEROW(8), DECODEROW(9), DECODEROW(10), DECODEROW(11),
+	DECODEROW(12), DECODEROW(13), DECODEROW(14), DECODEROW(15)
+};
+
+/* 0-99 to BCD */
+#define ENCODEROW(t) \
+	(t<<4)|0, (t<<4)|1, (t<<4)|2, (t<<4)|3, (t<<4)|4, \
+	(t<<4)|5, (t<<4)|6, (t<<4)|7, (t<<4)|8, (t<<4)|9
+
+static const byte bcdEncode[100] = {
+	ENCODEROW(0), ENCODEROW(1), ENCODEROW(2), ENCODEROW(3), ENCODEROW(4),
+	ENCODEROW(5), ENCODEROW(6), ENCODEROW(7), ENCODEROW(8), ENCODEROW(9)
+};
+
+static const int daysInMonth[13] = { 0, 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+static int IsBCD(byte b) {
+	return (b & 0x0f) <= 9 && b <= 0x99;
+}
+
+static int IsLeapYear(int year) {
+	return !(year % 4) && ((year % 100) || !(year % 400));
+}
+
+/* Date of a number of days since 1970-01-01, in the proleptic Gregorian calendar */
+static void CivilFromDays(long days, PLIFTIME t) {
+
+	long era, doe, yoe, doy, mp;
+
+	days += 719468;
+	era = (days >= 0 ? days : days - 146096) / 146097;
+	doe = days - era * 146097;
+	yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	mp = (5 * doy + 2) / 153;
+	t->day = doy - (153 * mp + 2) / 5 + 1;
+	t->month = mp < 10 ? mp + 3 : mp - 9;
+	t->year = yoe + era * 400 + (t->month <= 2);
+
+}
+
+/* Break a number of seconds since the epoch down, with no time zone involved */
+static void BreakDown(long long seconds, PLIFTIME t) {
+
+	long long days = seconds / SECONDSPERDAY;
+	long secs = seconds % SECONDSPERDAY;
+
+	if (secs < 0) {
+		secs += SECONDSPERDAY;
+		--days;
+	}
+
+	CivilFromDays((long)days, t);
+	t->hour = secs / 3600;
+	t->minute = (secs / 60) % 60;
+	t->second = secs % 60;
+
+}
+
+void PackLIFTime(PLIFTIME t, byte* timestamp) {
+	timestamp[0] = bcdEncode[((t->year % 100) + 100) % 100];
+	timestamp[1] = bcdEncode[t->month % 100];
+	timestamp[2] = bcdEncode[t->day % 100];
+	timestamp[3] = bcdEncode[t->hour % 100];
+	timestamp[4] = bcdEncode[t->minute % 100];
+	timestamp[5] = bcdEncode[t->second % 100];
+}
+
+int UnpackLIFTime(const byte* timestamp, PLIFTIME t) {
+
+	t->year = 1900 + bcdDecode[timestamp[0]];
+	if (t->year < FIRSTYEAR) t->year += 100;
+	t->month = bcdDecode[timestamp[1]];
+	t->day = bcdDecode[timestamp[2]];
+	t->hour = bcdDecode[timestamp[3]];
+	t->minute = bcdDecode[timestamp[4]];
+	t->second = bcdDecode[timestamp[5]];
+
+	return ValidLIFTimestamp(timestamp);
+
+}
+
+int ValidLIFTimestamp(const byte* timestamp) {
+
+	int n, year, month, day, lastDay;
+
+	for (n = 0; n < TIMESTAMPLENGTH; ++n) {
+		if (!IsBCD(timestamp[n])) return 0;
+	}
+
+	year = 1900 + bcdDecode[timestamp[0]];
+	if (year < FIRSTYEAR) year += 100;
+	month = bcdDecode[timestamp[1]];
+	day = bcdDecode[timestamp[2]];
+
+	if (month < 1 || month > 12) return 0;
+	lastDay = daysInMonth[month] + (month == 2 && IsLeapYear(year));
+	if (day < 1 || day > lastDay) return 0;
+
+	return bcdDecode[timestamp[3]] < 24 && bcdDecode[timestamp[4]] < 60 && bcdDecode[timestamp[5]] < 60;
+
+}
+
+void FormatLIFTimestamp(const byte* timestamp, char* buf) {
+
+	LIFTIME t;
+
+	UnpackLIFTime(timestamp, &t);
+	sprintf(buf, "%d-%02d-%02d %02d:%02d:%02d", t.year, t.month, t.day, t.hour, t.minute, t.second);
+
+}
+
+/* Value of exactly count decimal digits, or -1 if any of them isn't one */
+static int FixedDigits(const char* text, int count) {
+
+	int value = 0;
+
+	while (count--) {
+		if (*text < '0' || *text > '9') return -1;
+		value = value * 10 + (*text++ - '0');
+	}
+	return value;
+
+}
+
+int ParseLIFTimestamp(const char* text, byte* timestamp) {
+
+	LIFTIME t;
+	size_t length = strlen(text);
+
+	/* "YYYY-MM-DD", "YYYY-MM-DD hh:mm" or "YYYY-MM-DD hh:mm:ss", with every digit there and nothing else */
+	if (length != 10 && length != 16 && length != 19) return 0;
+	if (text[4] != '-' || text[7] != '-') return 0;
+	if (length > 10 && (text[10] != ' ' || text[13] != ':')) return 0;
+	if (length > 16 && text[16] != ':') return 0;
+
+	t.year = FixedDigits(text, 4);
+	t.month = FixedDigits(text + 5, 2);
+	t.day = FixedDigits(text + 8, 2);
+	t.hour = length > 10 ? FixedDigits(text + 11, 2) : 0;
+	t.minute = length > 10 ? FixedDigits(text + 14, 2) : 0;
+	t.second = length > 16 ? FixedDigits(text + 17, 2) : 0;
+
+	if (t.year < FIRSTYEAR || t.year > FIRSTYEAR + 99) return 0;
+	if (t.month < 1 || t.month > 12 || t.day < 1 || t.day > 31) return 0;
+	if (t.hour < 0 || t.hour > 99 || t.minute < 0 || t.minute > 99 || t.second < 0 || t.second > 99) return 0;
+
+	PackLIFTime(&t, timestamp);
+	return ValidLIFTimestamp(timestamp);
+
+}
+
+void LocalLIFTimestamp(time_t when, byte* timestamp) {
+
+	struct tm tm;
+	LIFTIME t;
+
+	localtime_r(&when, &tm);
+	t.year = tm.tm_year + 1900;
+	t.month = tm.tm_mon + 1;
+	t.day = tm.tm_mday;
+	t.hour = tm.tm_hour;
+	t.minute = tm.tm_min;
+	t.second = tm.tm_sec;
+	PackLIFTime(&t, timestamp);
+
+}
+
+void UTCLIFTimestamp(time_t when, byte* timestamp) {
+
+	LIFTIME t;
+
+	BreakDown((long long)when, &t);
+	PackLIFTime(&t, timestamp);
+
+}
@@ -0,0 +1,52 @@
+/* LIF timestamps
+ *
+ * LIF headers hold the date and time as six BCD bytes: year (two digits),
+ * month, day, hour, minute and second.
+ */
+
+#ifndef LIFTIME_H
+#define LIFTIME_H
+
+#include "lifheader.h"
+#include <time.h>
+
+#define TIMESTAMPLENGTH	6
+
+/* Two digit years from 70 to 99 are 1970-1999, the rest are 2000-2069 */
+#define FIRSTYEAR	1970
+
+/* Seconds since the epoch at the start of FIRSTYEAR + 100, 2070-01-01 00:00:00 UTC */
+#define LASTEPOCH	3155760000LL
+
+/* A LIF timestamp taken apart */
+typedef struct {
+	int year;	/* full year, FIRSTYEAR to FIRSTYEAR + 99 */
+	int month;
+	int day;
+	int hour;
+	int minute;
+	int second;
+} LIFTIME, *PLIFTIME;
+
+/* Pack a date and time into a 6 byte BCD timestamp */
+void PackLIFTime(PLIFTIME, byte*);
+
+/* Unpack a 6 byte BCD timestamp, returning 0 if it isn't a valid date and time */
+int UnpackLIFTime(const byte*, PLIFTIME);
+
+/* Is a 6 byte BCD timestamp a valid date and time? */
+int ValidLIFTimestamp(const byte*);
+
+/* Format a timestamp as "YYYY-MM-DD hh:mm:ss" into a buffer of TIMESTAMPTEXTLENGTH chars */
+void FormatLIFTimestamp(const byte*, char*);
+
+/* Parse "YYYY-MM-DD[ hh:mm[:ss]]" into a timestamp, returning 0 if it isn't valid */
+int ParseLIFTimestamp(const char*, byte*);
+
+/* Timestamp for a time in the local time zone */
+void LocalLIFTimestamp(time_t, byte*);
+
+/* Timestamp for a time in UTC */
+void UTCLIFTimestamp(time_t, byte*);
+
+#endif